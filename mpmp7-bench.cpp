@@ -0,0 +1,608 @@
+/*
+
+Benchmarks for the mpmp7 unique distance solver.
+
+Runs a fixed set of grid configurations taken from the README tables,
+several times each, and reports the wall clock time, the search tree
+nodes per second, the solutions and the arrangements with unique distances.
+
+    ./mpmp7-bench [-n REPS] [--json=FILE] [--perf]           -- run the default cases.
+    ./mpmp7-bench [-n REPS] [--json=FILE] [--perf] width dim ncounters -- run a single case.
+    ./mpmp7-bench [-n REPS] --specialized [width dim ncounters] -- compare the specialized and generic solvers.
+    ./mpmp7-bench --micro [width dim ncounters]              -- time the solver primitives.
+    ./mpmp7-bench --compare BASELINE.json CANDIDATE.json     -- compare two --json results.
+
+--specialized runs every specialized grid, or the one given, on a bounded
+workload: the same SPECIALIZEDPROBES random probes of the estimator with
+both solvers, and shows the estimated nodes and unique arrangements.
+
+--perf also counts cycles, instructions, cache and branch misses with the
+Linux perf_event_open interface, and reports the instructions per cycle
+and misses per search node.
+
+`make bench` runs the default cases and writes bench.json, `make benchcompare`
+compares that with BASELINE=FILE, and fails when the candidate is slower.
+
+*/
+#define NOMAIN 1
+#include "mpmp7-unique-distances.cpp"
+
+#include <chrono>
+#include <iomanip>
+#include <random>
+#include <sstream>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+
+/*
+ * A single benchmark configuration.
+ */
+struct BenchCase {
+    int width;
+    int dim;
+    int ncounters;
+};
+
+/*
+ * The default cases: README configurations which finish within seconds.
+ */
+const BenchCase defaultcases[] = {
+    { 6, 2, 6 }, { 7, 2, 7 }, { 8, 2, 7 }, { 8, 2, 8 },
+    { 3, 3, 3 }, { 3, 3, 4 }, { 4, 3, 6 },
+    { 2, 4, 3 }, { 3, 4, 3 },
+    { 2, 5, 2 }, { 2, 5, 3 },
+};
+
+/*
+ * The grids for the microbenchmarks: few, and many dimensions.
+ */
+const BenchCase microcases[] = {
+    { 7, 2, 7 }, { 4, 3, 6 }, { 3, 4, 3 }, { 2, 7, 2 },
+};
+
+/*
+ * Solve a grid, returning the wall clock time in seconds.
+ */
+double timesolve(Size size, int ncounters, const SolverOptions& opts, SolveResult& result)
+{
+    auto t0 = std::chrono::steady_clock::now();
+    result = solve(size, ncounters, opts);
+    auto t1 = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(t1-t0).count();
+}
+
+#define SPECIALIZEDPROBES 100000
+
+/*
+ * Compare the specialized and generic solvers for one grid, with the best of
+ * `reps` runs of each. Complete searches of most specialized grids take hours,
+ * so both run the same random probes of the estimator instead, which time the
+ * search kernels the specialization is for, and should give the same estimates.
+ */
+void benchspecialized(const BenchCase& bc, int reps)
+{
+    Size size(bc.dim, bc.width);
+    SolverOptions opts;
+    const SpecializedSolver *fixed = findspecialized(size, bc.ncounters);
+
+    SearchEstimate eg, es;
+    double tg = 1e99, ts = 1e99;
+    for (int i=0 ; i<reps ; i++) {
+        eg = estimateshape(Shape(size, bc.ncounters), opts, NULL, SPECIALIZEDPROBES);
+        tg = std::min(tg, eg.seconds);
+        if (fixed) {
+            es = fixed->probe(opts, SPECIALIZEDPROBES);
+            ts = std::min(ts, es.seconds);
+        }
+    }
+
+    std::cout << std::setw(5) << bc.width << std::setw(4) << bc.dim << std::setw(4) << bc.ncounters;
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << std::setw(12) << tg;
+    if (fixed)
+        std::cout << std::setw(12) << ts << std::setw(8) << std::setprecision(2) << tg/ts << "x";
+    else
+        std::cout << std::setw(12) << "-" << std::setw(9) << "-";
+    std::cout << std::scientific << std::setprecision(3) << std::setw(12) << eg.total[0] << std::setw(12) << eg.total[1] << std::defaultfloat;
+    if (fixed && (eg.total[0] != es.total[0] || eg.total[1] != es.total[1]))
+        std::cout << "  MISMATCH";
+    std::cout << "\n";
+}
+
+double median(std::vector<double> x)
+{
+    if (x.empty())
+        return 0;
+    std::sort(x.begin(), x.end());
+    size_t m = x.size()/2;
+    return x.size()%2 ? x[m] : (x[m-1]+x[m])/2;
+}
+
+// the median absolute deviation from the median.
+double mad(const std::vector<double>& x)
+{
+    double m = median(x);
+    std::vector<double> dev;
+    for (auto v : x)
+        dev.push_back(fabs(v-m));
+    return median(dev);
+}
+
+/*
+ * Hardware performance counters, counting this process in user mode.
+ *
+ * The counters are one perf_event group, so they cover exactly the same
+ * instructions. Counters the cpu, or a virtual machine, lacks are left out.
+ */
+enum { PERF_CYCLES, PERF_INSTRUCTIONS, PERF_CACHEMISSES, PERF_BRANCHMISSES, NPERF };
+
+const char *perfname(int counter)
+{
+    static const char *names[NPERF] = { "cycles", "instructions", "cachemisses", "branchmisses" };
+    return names[counter];
+}
+
+struct PerfCounters {
+    int fd[NPERF];
+    int leader;
+
+    PerfCounters() : leader(-1)
+    {
+        for (auto& f : fd)
+            f = -1;
+    }
+    ~PerfCounters()
+    {
+        for (auto f : fd)
+            if (f != -1)
+                ::close(f);
+    }
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    // returns false when no counter could be opened.
+    bool open()
+    {
+#ifdef __linux__
+        static const uint64_t configs[NPERF] = {
+            PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES
+        };
+        for (int c=0 ; c<NPERF ; c++) {
+            struct perf_event_attr attr;
+            memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = configs[c];
+            attr.disabled = leader == -1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_GROUP;
+            fd[c] = syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0);
+            if (leader == -1)
+                leader = fd[c];
+        }
+#endif
+        return leader != -1;
+    }
+
+    void start()
+    {
+#ifdef __linux__
+        ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#endif
+    }
+
+    // stop counting, and return the counts, -1 for missing counters.
+    void stop(double *counts)
+    {
+        for (int c=0 ; c<NPERF ; c++)
+            counts[c] = -1;
+#ifdef __linux__
+        ioctl(leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+        uint64_t values[1+NPERF];
+        if (read(leader, values, sizeof(values)) <= 0)
+            return;
+        // the group has the opened counters, in the order they were opened.
+        int i = 0;
+        for (int c=0 ; c<NPERF ; c++)
+            if (fd[c] != -1 && i < int(values[0]))
+                counts[c] = values[1+i++];
+#endif
+    }
+};
+
+/*
+ * The results of all repetitions of one case.
+ */
+struct BenchResult {
+    BenchCase bc;
+    SolveResult result;
+    std::vector<double> times;
+    bool mismatch;           // repetitions found different solutions.
+    bool perf;
+    double counts[NPERF];    // the average of each perf counter over the repetitions, -1 when missing.
+
+    double median() const { return ::median(times); }
+};
+
+// `perf` is null, or open counters to read around each repetition.
+BenchResult benchcase(const BenchCase& bc, int reps, PerfCounters *perf)
+{
+    Size size(bc.dim, bc.width);
+    BenchResult br;
+    br.bc = bc;
+    br.mismatch = false;
+    br.perf = perf != nullptr;
+    for (int c=0 ; c<NPERF ; c++)
+        br.counts[c] = 0;
+    for (int r=0 ; r<reps ; r++) {
+        SolveResult result;
+        double counts[NPERF];
+        if (perf)
+            perf->start();
+        br.times.push_back(timesolve(size, bc.ncounters, SolverOptions(), result));
+        if (perf) {
+            perf->stop(counts);
+            for (int c=0 ; c<NPERF ; c++)
+                br.counts[c] = counts[c]<0 || br.counts[c]<0 ? -1 : br.counts[c] + counts[c]/reps;
+        }
+        if (r && (result.solutions != br.result.solutions || result.countu != br.result.countu || result.nodes != br.result.nodes))
+            br.mismatch = true;
+        br.result = result;
+    }
+
+    double t = br.median();
+    std::cout << std::setw(5) << bc.width << std::setw(4) << bc.dim << std::setw(4) << bc.ncounters;
+    std::cout << std::fixed << std::setprecision(4) << std::setw(10) << t << std::setw(10) << *std::min_element(br.times.begin(), br.times.end());
+    std::cout << std::setprecision(0) << std::setw(14) << (t>0 ? br.result.nodes/t : 0);
+    std::cout << std::setw(12) << br.result.nodes << std::setw(10) << br.result.solutions << std::setw(12) << br.result.countu;
+    if (perf) {
+        auto ratio = [](double a, double b) -> std::string {
+            if (a<0 || b<=0)
+                return "-";
+            std::ostringstream os;
+            os << std::fixed << std::setprecision(3) << a/b;
+            return os.str();
+        };
+        double nodes = std::max(br.result.nodes, uint64_t(1));
+        std::cout << std::setw(8) << ratio(br.counts[PERF_INSTRUCTIONS], br.counts[PERF_CYCLES]);
+        std::cout << std::setw(12) << ratio(br.counts[PERF_CACHEMISSES], nodes) << std::setw(12) << ratio(br.counts[PERF_BRANCHMISSES], nodes);
+    }
+    if (br.mismatch)
+        std::cout << "  MISMATCH";
+    std::cout << "\n";
+    return br;
+}
+
+volatile uint64_t microsink;   // keeps the results of the timed calls alive.
+
+/*
+ * Time `op(i)` for doubling counts until that takes at least 50ms,
+ * then report the nanoseconds and time stamp counter cycles per call.
+ */
+template<typename OP>
+void microbench(const char *name, OP op)
+{
+    for (uint64_t count = 1 ; ; count *= 2) {
+        uint64_t sink = 0;
+        auto t0 = std::chrono::steady_clock::now();
+        uint64_t c0 = readtsc();
+        for (uint64_t i=0 ; i<count ; i++)
+            sink += op(i);
+        uint64_t cycles = readtsc()-c0;
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now()-t0).count();
+        microsink = sink;
+        if (seconds >= 0.05) {
+            std::cout << "    " << std::left << std::setw(24) << name << std::right << std::fixed;
+            std::cout << std::setprecision(2) << std::setw(16) << seconds*1e9/count;
+            std::cout << std::defaultfloat << std::setprecision(4) << std::setw(12) << (cycles ? double(count)/cycles : 0) << "\n";
+            return;
+        }
+    }
+}
+
+/*
+ * Microbenchmarks of the solver primitives, on random points and arrangements
+ * of a grid. Each uses a small set of inputs, so they stay in the cache.
+ */
+void benchprimitives(const BenchCase& bc)
+{
+    Size size(bc.dim, bc.width);
+    int npoints = pow(bc.width, bc.dim);
+    std::vector<Point> points = allpoints(size);
+    std::mt19937 rng(1);
+
+    const int NINPUTS = 1024;   // a power of 2.
+    std::vector<Point> p(NINPUTS), q(NINPUTS);
+    std::vector<int> dists(NINPUTS);
+    std::vector<Arrangement> arrangements(NINPUTS), images(NINPUTS);
+    std::vector<std::pair<int, Permutation>> transforms(NINPUTS, { 0, Permutation(bc.dim) });
+    for (int i=0 ; i<NINPUTS ; i++) {
+        p[i] = points[rng()%npoints];
+        q[i] = points[rng()%npoints];
+        dists[i] = rng()%(maxdist2(size)+1);
+
+        // distinct random points.
+        IndexArrangement ia;
+        while (ia.n < bc.ncounters) {
+            int ix = rng()%npoints;
+            if (std::find(ia.begin(), ia.end(), ix) == ia.end())
+                ia.add(ix);
+        }
+        arrangements[i] = ia.decode(size);
+
+        auto& t = transforms[i];
+        t.first = rng()%(1<<bc.dim);
+        std::shuffle(&t.second[0], &t.second[0]+bc.dim, rng);
+        images[i] = rotatearrangement(size, t.first, t.second, arrangements[i]);
+    }
+    const size_t NSOLUTIONS = 8;
+    std::vector<Arrangement> solutions(arrangements.begin(), arrangements.begin()+NSOLUTIONS);
+    std::unique_ptr<FixedSet> used(new FixedSet(maxdist2(size)));  // too large for the stack.
+    GridSymmetry symmetry(size);
+    int kernel = bestkernel();
+
+    std::cout << bc.width << " " << bc.dim << " " << bc.ncounters << ":\n";
+    std::cout << "    primitive                          ns/op   ops/cycle\n";
+    microbench("dist2", [&](uint64_t i) {
+        return dist2(p[i%NINPUTS], q[i%NINPUTS]);
+    });
+    microbench("hasuniquedistance", [&](uint64_t i) {
+        return hasuniquedistance(size, arrangements[i%NINPUTS]);
+    });
+    microbench("FixedSet::add+remove", [&](uint64_t i) {
+        int d = dists[i%NINPUTS];
+        bool added = used->add(d);
+        used->remove(d);
+        return added;
+    });
+    auto combinations = generatecombinations(bc.ncounters, npoints);
+    auto it = combinations.begin();
+    microbench("iter::operator++", [&](uint64_t) {
+        if (!(++it != combinations.end()))
+            it = combinations.begin();
+        return (*it)[0];
+    });
+    microbench("rotatepoint", [&](uint64_t i) {
+        auto& t = transforms[i%NINPUTS];
+        return rotatepoint(size, t.first, t.second, p[i%NINPUTS])[0];
+    });
+    microbench("rotatearrangement", [&](uint64_t i) {
+        auto& t = transforms[i%NINPUTS];
+        return rotatearrangement(size, t.first, t.second, arrangements[i%NINPUTS]).n;
+    });
+    microbench("istransformof", [&](uint64_t i) {
+        return istransformof(size, arrangements[i%NINPUTS], images[i%NINPUTS]);
+    });
+    microbench("containstransform", [&](uint64_t i) {
+        return containstransform(size, solutions, arrangements[NSOLUTIONS + i%(NINPUTS-NSOLUTIONS)]);
+    });
+    microbench("GridSymmetry::canonical", [&](uint64_t i) {
+        return symmetry.canonical(kernel, IndexArrangement::encode(size, arrangements[i%NINPUTS]))[0];
+    });
+}
+
+/*
+ * Write the results as JSON, one case per line.
+ */
+bool writejson(const char *path, const std::vector<BenchResult>& results, int reps)
+{
+    std::ofstream os(path);
+    os << "{\"benchmark\":\"mpmp7\",\"kernel\":\"" << kernelname(bestkernel()) << "\",\"repetitions\":" << reps << ",\"cases\":[\n";
+    os << std::setprecision(9);
+    for (size_t i=0 ; i<results.size() ; i++) {
+        auto& br = results[i];
+        double t = br.median();
+        os << "{\"width\":" << br.bc.width << ",\"dim\":" << br.bc.dim << ",\"n\":" << br.bc.ncounters
+           << ",\"solutions\":" << br.result.solutions << ",\"countu\":" << br.result.countu << ",\"nodes\":" << br.result.nodes
+           << ",\"median\":" << t << ",\"nodespersecond\":" << (t>0 ? br.result.nodes/t : 0);
+        for (int c=0 ; br.perf && c<NPERF ; c++)
+            if (br.counts[c] >= 0)
+                os << ",\"" << perfname(c) << "\":" << br.counts[c];
+        os << ",\"times\":[";
+        for (size_t r=0 ; r<br.times.size() ; r++)
+            os << (r ? "," : "") << br.times[r];
+        os << "]}" << (i+1<results.size() ? "," : "") << "\n";
+    }
+    os << "]}\n";
+    return bool(os);
+}
+
+// the number after `"key":` in a line of JSON, or 0.
+double jsonnumber(const std::string& line, const char *key)
+{
+    auto i = line.find(std::string("\"") + key + "\":");
+    return i==std::string::npos ? 0 : strtod(line.c_str()+i+strlen(key)+3, nullptr);
+}
+
+/*
+ * Read the cases of a --json file, returns false when it can not be read,
+ * or has no cases.
+ */
+bool readjson(const char *path, std::vector<BenchResult>& results)
+{
+    std::ifstream is(path);
+    if (!is)
+        return false;
+    std::string line;
+    while (std::getline(is, line)) {
+        if (line.compare(0, 9, "{\"width\":") != 0)
+            continue;
+        BenchResult br;
+        br.bc = { int(jsonnumber(line, "width")), int(jsonnumber(line, "dim")), int(jsonnumber(line, "n")) };
+        br.result.solutions = jsonnumber(line, "solutions");
+        br.result.countu = jsonnumber(line, "countu");
+        br.result.nodes = jsonnumber(line, "nodes");
+        br.mismatch = false;
+        auto i = line.find("\"times\":[");
+        if (i == std::string::npos)
+            return false;
+        for (const char *p = line.c_str()+i+9 ; *p && *p != ']' ; ) {
+            char *e;
+            br.times.push_back(strtod(p, &e));
+            if (e == p)
+                return false;
+            p = *e==',' ? e+1 : e;
+        }
+        results.push_back(br);
+    }
+    return !results.empty();
+}
+
+/*
+ * Compare the cases of two --json results.
+ *
+ * A case changed when the difference of the medians is more than 3 times its
+ * noise, estimated from the MAD of both, and more than 5%, as runs on
+ * a busy machine drift by more than the noise within one run.
+ * Returns 1 when a case got slower, found different solutions, or is missing
+ * from the candidate.
+ */
+int compareresults(const char *basepath, const char *candpath)
+{
+    std::vector<BenchResult> base, cand;
+    if (!readjson(basepath, base) || !readjson(candpath, cand)) {
+        std::cout << "could not read benchmark cases from " << basepath << " or " << candpath << "\n";
+        return 1;
+    }
+
+    int regressions = 0, improvements = 0, mismatches = 0;
+    std::cout << "width dim   n  baseline candidate   change     noise\n";
+    for (auto& c : cand) {
+        auto b = std::find_if(base.begin(), base.end(), [&](const BenchResult& b) {
+            return b.bc.width==c.bc.width && b.bc.dim==c.bc.dim && b.bc.ncounters==c.bc.ncounters;
+        });
+        std::cout << std::setw(5) << c.bc.width << std::setw(4) << c.bc.dim << std::setw(4) << c.bc.ncounters;
+        if (b == base.end()) {
+            std::cout << "  not in the baseline\n";
+            continue;
+        }
+        double mb = b->median(), mc = c.median();
+        double noise = 1.4826 * sqrt(mad(b->times)*mad(b->times) + mad(c.times)*mad(c.times));  // MAD to standard deviation.
+        double change = mb>0 ? (mc-mb)/mb : 0;
+        std::cout << std::fixed << std::setprecision(4) << std::setw(10) << mb << std::setw(10) << mc;
+        std::cout << std::showpos << std::setprecision(1) << std::setw(8) << 100*change << "%" << std::noshowpos;
+        std::cout << std::setprecision(4) << std::setw(10) << noise;
+        if (b->result.solutions != c.result.solutions || b->result.countu != c.result.countu) {
+            std::cout << "  MISMATCH";
+            mismatches++;
+        }
+        else if (fabs(mc-mb) > 3*noise && fabs(change) > 0.05) {
+            std::cout << (mc > mb ? "  REGRESSION" : "  improvement");
+            (mc > mb ? regressions : improvements)++;
+        }
+        std::cout << "\n";
+    }
+    for (auto& b : base) {
+        bool found = std::any_of(cand.begin(), cand.end(), [&](const BenchResult& c) {
+            return b.bc.width==c.bc.width && b.bc.dim==c.bc.dim && b.bc.ncounters==c.bc.ncounters;
+        });
+        if (!found) {
+            std::cout << std::setw(5) << b.bc.width << std::setw(4) << b.bc.dim << std::setw(4) << b.bc.ncounters << "  MISSING from the candidate\n";
+            mismatches++;
+        }
+    }
+    std::cout << regressions << " regressions, " << improvements << " improvements, " << mismatches << " different or missing results.\n";
+    return regressions || mismatches ? 1 : 0;
+}
+
+int main(int argc, char**argv)
+{
+    int reps = 5;
+    const char *json = nullptr;
+    bool specialized = false;
+    bool micro = false;
+    bool perf = false;
+
+    while (argc>=2 && argv[1][0]=='-') {
+        if (strcmp(argv[1], "-n")==0 && argc>=3) {
+            reps = std::max(1, int(strtol(argv[2], 0, 0)));
+            argv+=2; argc-=2;
+        }
+        else if (strncmp(argv[1], "--json=", 7)==0) {
+            json = argv[1]+7;
+            argv++; argc--;
+        }
+        else if (strcmp(argv[1], "--compare")==0) {
+            if (argc != 4) {
+                std::cout << "expected --compare BASELINE.json CANDIDATE.json\n";
+                return 1;
+            }
+            return compareresults(argv[2], argv[3]);
+        }
+        else if (strcmp(argv[1], "--perf")==0) {
+            perf = true;
+            argv++; argc--;
+        }
+        else if (strcmp(argv[1], "--micro")==0) {
+            micro = true;
+            argv++; argc--;
+        }
+        else if (strcmp(argv[1], "--specialized")==0) {
+            specialized = true;
+            argv++; argc--;
+        }
+        else {
+            argc = 0;
+            break;
+        }
+    }
+
+    std::vector<BenchCase> cases;
+    if (argc==4)
+        cases.push_back({ int(strtol(argv[1], 0, 0)), int(strtol(argv[2], 0, 0)), int(strtol(argv[3], 0, 0)) });
+    else if (argc==1 && micro)
+        cases.assign(std::begin(microcases), std::end(microcases));
+    else if (argc==1 && specialized) {
+        for (auto& s : specializedsolvers)
+            cases.push_back({ s.width, s.dim, s.ncounters });
+    }
+    else if (argc==1)
+        cases.assign(std::begin(defaultcases), std::end(defaultcases));
+    else {
+        std::cout << "Usage: " << argv[0] << " [-n REPS] [--json=FILE] [--perf] [width dim ncounters]\n";
+        std::cout << "       " << argv[0] << " [-n REPS] --specialized [width dim ncounters]\n";
+        std::cout << "       " << argv[0] << " --micro [width dim ncounters]\n";
+        std::cout << "       " << argv[0] << " --compare BASELINE.json CANDIDATE.json\n";
+        return 1;
+    }
+
+    if (micro) {
+        std::cout << "Using the " << kernelname(bestkernel()) << " kernel, ops/cycle counts time stamp counter cycles.\n";
+        for (auto& bc : cases)
+            benchprimitives(bc);
+        return 0;
+    }
+    if (specialized) {
+        std::cout << "Best of " << reps << " runs of " << SPECIALIZEDPROBES << " probes.\n";
+        std::cout << "width dim   n     generic specialized speedup   est.nodes est.unique\n";
+        for (auto& bc : cases)
+            benchspecialized(bc, reps);
+        return 0;
+    }
+
+    std::cout << "Using the " << kernelname(bestkernel()) << " kernel, median and best of " << reps << " runs.\n";
+    PerfCounters counters;
+    if (perf && !counters.open()) {
+        std::cout << "perf counters are not available, see /proc/sys/kernel/perf_event_paranoid\n";
+        perf = false;
+    }
+    std::cout << "width dim   n    median      best  nodes/second       nodes solutions      unique";
+    std::cout << (perf ? "     IPC cache/node branch/node\n" : "\n");
+    std::vector<BenchResult> results;
+    for (auto& bc : cases)
+        results.push_back(benchcase(bc, reps, perf ? &counters : nullptr));
+
+    if (json && !writejson(json, results, reps)) {
+        std::cout << "could not write " << json << "\n";
+        return 1;
+    }
+    for (auto& br : results)
+        if (br.mismatch)
+            return 1;
+}
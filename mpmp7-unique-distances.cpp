@@ -30,12 +30,32 @@ Author: Willem Hengeveld <itsme@xs4all.nl>
 
 
 #include <vector>
+#include <utility>
+#include <type_traits>
+#include <memory>
 #include <set>
+#include <sstream>
+#include <unordered_set>
 #include <cmath>
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <charconv>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <random>
+#include <thread>
 #include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <stdio.h>
 #include <string.h>
 #include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #define MAXDIM 8
 #define MAXCOUNTERS 10
@@ -45,7 +65,7 @@ Author: Willem Hengeveld <itsme@xs4all.nl>
 /*
  * Some simple integer arithmetic functions.
  */
-uint64_t pow(int a, int b)
+constexpr uint64_t pow(int a, int b)
 {
     uint64_t result = 1;
     if (a==0)
@@ -54,7 +74,7 @@ uint64_t pow(int a, int b)
         result *= a;
     return result;
 }
-int square(int x) { return x*x; }
+constexpr int square(int x) { return x*x; }
 
 
 
@@ -78,6 +98,14 @@ struct FixedSet {
         bits[index] |= 1<<shift;
         return true;
     }
+    bool contains(int value) const
+    {
+        return (bits[value / (8*sizeof(int))] >> (value % (8*sizeof(int)))) & 1;
+    }
+    void remove(int value)
+    {
+        bits[value / (8*sizeof(int))] &= ~(1<<(value % (8*sizeof(int))));
+    }
 };
 
 
@@ -97,6 +125,85 @@ struct Size {
     }
 };
 
+/*
+ * The largest squared distance between two points in the grid.
+ */
+int maxdist2(Size size)
+{
+    return size.dim*square(size.width-1);
+}
+
+
+/*
+ * The hot kernels are compiled for several instruction sets, the best
+ * one supported by the cpu is selected once at startup.
+ */
+enum { KERNEL_GENERIC, KERNEL_AVX2, KERNEL_AVX512, NKERNELS };
+
+#if defined(__x86_64__) || defined(__i386__)
+#define KERNEL_X86 1
+#define TARGET_AVX2   __attribute__((target("avx2,fma,bmi,bmi2,popcnt")))
+#define TARGET_AVX512 __attribute__((target("avx512f,avx512bw,avx512vl,avx512dq,avx2,fma,bmi,bmi2,popcnt")))
+#include <immintrin.h>
+#include <x86intrin.h>
+#else
+#define TARGET_AVX2
+#define TARGET_AVX512
+#endif
+
+// kernel bodies are inlined into each of the instruction set specific functions.
+#define ALWAYS_INLINE inline __attribute__((always_inline))
+
+const char *kernelname(int kernel)
+{
+    static const char *names[NKERNELS] = { "generic", "avx2", "avx512" };
+    return kernel>=0 && kernel<NKERNELS ? names[kernel] : "?";
+}
+
+// returns the kernel with this name, or -1.
+int findkernel(const char *name)
+{
+    for (int k=0 ; k<NKERNELS ; k++)
+        if (strcmp(name, kernelname(k))==0)
+            return k;
+    return -1;
+}
+
+bool kernelsupported(int kernel)
+{
+    switch (kernel) {
+        case KERNEL_GENERIC: return true;
+#ifdef KERNEL_X86
+        case KERNEL_AVX2: return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") && __builtin_cpu_supports("bmi2") && __builtin_cpu_supports("popcnt");
+        case KERNEL_AVX512: return kernelsupported(KERNEL_AVX2) && __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512vl") && __builtin_cpu_supports("avx512dq");
+#endif
+    }
+    return false;
+}
+
+// the fastest kernel this cpu can run.
+int bestkernel()
+{
+    static int best = -1;
+    if (best == -1) {
+        best = KERNEL_GENERIC;
+        for (int k=0 ; k<NKERNELS ; k++)
+            if (kernelsupported(k))
+                best = k;
+    }
+    return best;
+}
+
+// the time stamp counter, for timing with little overhead, or 0 when the cpu has none.
+inline uint64_t readtsc()
+{
+#ifdef KERNEL_X86
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
 
 /*
  * Set of templates for convenient construction of Point and Permutation objects:
@@ -262,12 +369,18 @@ struct Arrangement {
         return os;
     }
 
+    // compare as sets of points: sorted, and without duplicates.
     friend bool operator==(const Arrangement& a,const Arrangement& b)
     {
-        std::set<Point> seta(a.begin(), a.end());
-        std::set<Point> setb(b.begin(), b.end());
+        Point sa[MAXCOUNTERS], sb[MAXCOUNTERS];
+        Point *ea = std::copy(a.begin(), a.end(), sa);
+        Point *eb = std::copy(b.begin(), b.end(), sb);
+        std::sort(sa, ea);
+        std::sort(sb, eb);
+        ea = std::unique(sa, ea);
+        eb = std::unique(sb, eb);
 
-        return seta == setb;
+        return std::equal(sa, ea, sb, eb);
     }  
 };
 
@@ -275,17 +388,64 @@ struct Arrangement {
 /*
  * Generate all possible combinations of 'nitems' choices of `total` items in lexicographical order.
  */
+/*
+ * Numbers of combinations and their ranks, C(15*15*15, 9) for example,
+ * need more than 64 bits, they are kept in 128-bit integers.
+ */
+typedef unsigned __int128 Rank;
+
+std::string tostring(Rank r)
+{
+    std::string s;
+    do {
+        s.insert(s.begin(), char('0' + int(r % 10)));
+        r /= 10;
+    } while (r);
+    return s;
+}
+
+/*
+ * The binomial coefficient C(n, k), saturating at the largest Rank.
+ */
+Rank binomial(uint64_t n, int k)
+{
+    if (k < 0 || uint64_t(k) > n)
+        return 0;
+    // most binomials fit in 64 bits, where the divisions are much cheaper.
+    uint64_t r64 = 1;
+    int i64 = 1;
+    for ( ; i64 <= k ; i64++) {
+        uint64_t m = n-k+i64;
+        uint64_t q;
+        if (__builtin_mul_overflow(r64, m, &q))
+            break;
+        r64 = q/i64;
+    }
+    if (i64 > k)
+        return r64;
+    Rank r = 1;
+    for (int i = 1 ; i <= k ; i++) {
+        // r*m/i is exact, but r*m may overflow, so split r into r/i and r%i.
+        uint64_t m = n-k+i;
+        Rank q;
+        if (__builtin_mul_overflow(r/i, Rank(m), &q) || __builtin_add_overflow(q, (r%i)*m/i, &r))
+            return ~Rank(0);
+    }
+    return r;
+}
+
 struct generatecombinations {
     struct iter {
         int nitems;       // the number of item to place on the grid.
         int totalchoices;           // the number of positions a item can be in the grid.
+        bool done;        // set after the last combination was passed.
 
         std::vector<int> c;
 
-        iter() : nitems(0), totalchoices(0) { }  // 'end'
+        iter() : nitems(0), totalchoices(0), done(true) { }  // 'end'
 
         iter(int nitems, uint64_t totalchoices)
-            : nitems(nitems), totalchoices(totalchoices)
+            : nitems(nitems), totalchoices(totalchoices), done(nitems > totalchoices)
         {
             c.resize(nitems);
             for (int i=0 ; i < nitems ; i++)
@@ -301,7 +461,8 @@ struct generatecombinations {
             auto last = c.end();
             auto i = last;
 
-            if (c[0] == totalchoices-nitems) {
+            if (nitems==0 || c[0] == totalchoices-nitems) {
+                done = true;
                 return *this;
             }
             while (*(--i) == totalchoices-(last-i));
@@ -322,7 +483,7 @@ struct generatecombinations {
         }
         bool operator!=(const iter& rhs) const
         {
-            return c[0] != totalchoices-nitems;
+            return done != rhs.done;
         }
     };
 
@@ -335,19 +496,11 @@ struct generatecombinations {
     auto begin() { return iter(nitems, totalchoices); }
     auto end() { return iter(); }
 
-    static uint64_t totalcombinations(int nitems, int totalchoices)
+    static Rank totalcombinations(int nitems, uint64_t totalchoices)
     {
         if (totalchoices==0)
             return 0;
-        uint64_t a = 1;
-        uint64_t b = totalchoices;
-        for (int i = 0 ; i < nitems ; i++) {
-            a *= b;
-            a /= i+1;
-            b -= 1;
-        }
-        return a;
-
+        return binomial(totalchoices, nitems);
     }
 };
 
@@ -357,7 +510,7 @@ struct generatecombinations {
  */
 bool hasuniquedistance(Size size, const Arrangement& a)
 {
-    FixedSet distances(pow(size.width-1, size.dim)*size.dim);
+    FixedSet distances(maxdist2(size));
     for (auto i = a.begin() ; i != a.end() ; ++i)
     {
         for (auto j = i+1; j != a.end() ; ++j)
@@ -371,36 +524,6 @@ bool hasuniquedistance(Size size, const Arrangement& a)
 }
 
 
-/*
- * Output an arrangement in a possibly readable way.
- */
-void printarrangement(Size size, const Arrangement& a)
-{
-    if (size.dim == 2) {
-        for (int y = 0 ; y < size.width ; y++) {
-            for (int x = 0 ; x < size.width ; x++)
-                std::cout << (a.contains(make<Point>(x, y)) ? '*' : '.');
-            std::cout << "\n";
-        }
-        std::cout << "\n";
-    }
-    else if (size.dim == 3) {
-        for (int y = 0 ; y < size.width ; y++) {
-            for (int z = 0 ; z < size.width ; z++) {
-                for (int x = 0 ; x < size.width ; x++)
-                    std::cout << (a.contains(make<Point>(x, y, z)) ? '*' : '.');
-                std::cout << "  ";
-            }
-            std::cout << "\n";
-        }
-        std::cout << "\n";
-    }
-    else {
-        std::cout << a << "\n";
-    }
-}
-
-
 /*
  *  This object represents a permutation of coordinates.
  *  It can iterate over all possible permutations, and can
@@ -453,6 +576,212 @@ Arrangement rotatearrangement(Size size, int flip, const Permutation& perm, cons
 }
 
 
+/*
+ * A PackedPoint keeps up to 8 coordinates, each less than PACKEDMAXWIDTH,
+ * in the bytes of a single 64-bit word: coordinate `i` is in byte `i`.
+ *
+ * Distances and transforms work on all coordinates at once using
+ * SWAR arithmetic ( SIMD within a register ).
+ */
+#define PACKEDMAXWIDTH 16
+
+struct PackedPoint {
+    uint64_t v;
+
+    static constexpr uint64_t LOW  = 0x0101010101010101;  // 0x01 in each byte.
+    static constexpr uint64_t HIGH = 0x8080808080808080;  // 0x80 in each byte.
+
+    PackedPoint() : v(0) { }
+    explicit PackedPoint(uint64_t v) : v(v) { }
+    explicit PackedPoint(const Point& p)
+        : v(0)
+    {
+        for (int i=0 ; i<p.n ; i++)
+            v |= uint64_t(p[i]) << (8*i);
+    }
+
+    // can points in a `size` grid be packed.
+    static bool fits(Size size) { return size.width <= PACKEDMAXWIDTH && size.dim <= 8; }
+
+    int operator[](int i) const { return (v >> (8*i)) & 0xFF; }
+
+    Point unpack(int dim) const
+    {
+        Point p(dim);
+        for (int i=0 ; i<dim ; i++)
+            p[i] = (*this)[i];
+        return p;
+    }
+
+    friend bool operator==(PackedPoint p, PackedPoint q) { return p.v == q.v; }
+    friend bool operator!=(PackedPoint p, PackedPoint q) { return p.v != q.v; }
+    friend bool operator<(PackedPoint p, PackedPoint q) { return p.v < q.v; }
+
+    /*
+     * The absolute difference of each pair of coordinates.
+     *
+     * Setting the high bit before subtracting keeps borrows from
+     * crossing into the next byte, the high bit of the result
+     * then tells which of the two coordinates was larger.
+     */
+    friend uint64_t absdiff(PackedPoint p, PackedPoint q)
+    {
+        uint64_t pq = ((p.v | HIGH) - q.v);
+        uint64_t qp = ((q.v | HIGH) - p.v);
+        uint64_t pbigger = ((pq & HIGH) >> 7) * 0xFF;
+        return ((pq ^ HIGH) & pbigger) | ((qp ^ HIGH) & ~pbigger);
+    }
+
+    /*
+     * Calculate the square of the distance between two points.
+     *
+     * Each difference is at most 15, so the square of each is built in
+     * its own byte from the 4 shifted copies selected by the bits of
+     * the difference. The bytes are then summed pairwise into 16-bit
+     * lanes, and those are summed with a single multiplication.
+     */
+    friend int dist2(PackedPoint p, PackedPoint q)
+    {
+        uint64_t d = absdiff(p, q);
+        uint64_t sq = 0;
+        for (int j=0 ; j<4 ; j++)
+            sq += (d << j) & (((d >> j) & LOW) * 0xFF);
+
+        uint64_t s = (sq & 0x00FF00FF00FF00FF) + ((sq >> 8) & 0x00FF00FF00FF00FF);
+        return (s * 0x0001000100010001) >> 48;
+    }
+};
+
+/*
+ *  The rotation and reflection of `rotatepoint`, prepared for PackedPoints:
+ *  the permutation is a byte shuffle, and the reflection subtracts
+ *  the flipped coordinates from width-1.
+ */
+struct PackedTransform {
+    int dim;
+    uint8_t perm[8];
+    uint64_t flipmask;   // 0xFF in the bytes of reflected coordinates.
+    uint64_t flipvalue;  // width-1 in the bytes of reflected coordinates.
+    uint8_t shuffle[16]; // `perm` for a 16 byte shuffle, unused bytes take the zero byte 8.
+
+    PackedTransform(Size size, int flip, const Permutation& p)
+        : dim(size.dim), flipmask(0), flipvalue(0)
+    {
+        memset(shuffle, 8, sizeof(shuffle));
+        for (int i=0 ; i<dim ; i++) {
+            perm[i] = p[i];
+            shuffle[i] = p[i];
+            if ((flip>>i)&1) {
+                flipmask |= uint64_t(0xFF) << (8*i);
+                flipvalue |= uint64_t(size.width-1) << (8*i);
+            }
+        }
+    }
+
+    ALWAYS_INLINE PackedPoint operator()(PackedPoint p) const
+    {
+#if defined(__GNUC__) && !defined(__clang__)
+        // a byte shuffle, this becomes a single pshufb in the avx2 and avx512 kernels.
+        typedef uint8_t bytes __attribute__((vector_size(16)));
+        bytes b = { }, ctl;
+        memcpy(&b, &p.v, 8);
+        memcpy(&ctl, shuffle, 16);
+        b = __builtin_shuffle(b, ctl);
+        uint64_t q;
+        memcpy(&q, &b, 8);
+#else
+        uint64_t q = 0;
+        for (int i=0 ; i<dim ; i++)
+            q |= ((p.v >> (8*perm[i])) & 0xFF) << (8*i);
+#endif
+        // coordinates are at most width-1, so this never borrows.
+        return PackedPoint((q & ~flipmask) | (flipvalue - (q & flipmask)));
+    }
+};
+
+/*
+ *  All rotations and reflections of a grid, in the order `istransformof` tries them.
+ */
+std::vector<PackedTransform> packedtransforms(Size size)
+{
+    std::vector<PackedTransform> transforms;
+    int nrreflections = 1<<size.dim;
+
+    Permutation perm(size.dim);
+
+    for (int flip = 0 ; flip<nrreflections ; flip++)
+    {
+        do {
+            transforms.emplace_back(size, flip, perm);
+        } while (perm.next());
+    }
+    return transforms;
+}
+
+/*
+ *  `packedtransforms` of the grid used last on this thread, which is built
+ *  again only when the grid changes: for 8 dimensions there are 10 million.
+ */
+const std::vector<PackedTransform>& cachedtransforms(Size size)
+{
+    static thread_local Size cached;
+    static thread_local std::vector<PackedTransform> transforms;
+    if (transforms.empty() || cached.dim != size.dim || cached.width != size.width) {
+        transforms = packedtransforms(size);
+        cached = size;
+    }
+    return transforms;
+}
+
+/*
+ *  An arrangement of PackedPoints, kept sorted so two
+ *  arrangements can be compared element by element.
+ */
+struct PackedArrangement {
+    PackedPoint counters[MAXCOUNTERS];
+    int n;
+
+    PackedArrangement() : n(0) { }
+    explicit PackedArrangement(const Arrangement& a)
+        : n(0)
+    {
+        for (auto& p : a)
+            add(PackedPoint(p));
+    }
+
+    // insert a point, keeping the points sorted.
+    void add(PackedPoint p)
+    {
+        int i = n++;
+        while (i>0 && p < counters[i-1]) {
+            counters[i] = counters[i-1];
+            i--;
+        }
+        counters[i] = p;
+    }
+
+    const PackedPoint*begin() const { return &counters[0]; }
+    const PackedPoint*end() const { return &counters[0]+n; }
+
+    ALWAYS_INLINE PackedArrangement transformed(const PackedTransform& t) const
+    {
+        PackedArrangement b;
+        for (auto p : *this)
+            b.add(t(p));
+        return b;
+    }
+
+    friend bool operator==(const PackedArrangement& a, const PackedArrangement& b)
+    {
+        return a.n==b.n && std::equal(a.begin(), a.end(), b.begin());
+    }
+    friend bool operator<(const PackedArrangement& a, const PackedArrangement& b)
+    {
+        return std::lexicographical_compare(a.begin(), a.end(), b.begin(), b.end());
+    }
+};
+
+
 /*
  *  Checks if the arrangement `a` is a rotated or reflected transformation
  *  of arrangement `b`.
@@ -463,6 +792,15 @@ Arrangement rotatearrangement(Size size, int flip, const Permutation& perm, cons
  */
 bool istransformof(Size size, const Arrangement& a, const Arrangement& b)
 {
+    if (PackedPoint::fits(size)) {
+        PackedArrangement pa(a);
+        PackedArrangement pb(b);
+        for (auto& t : cachedtransforms(size))
+            if (pa.transformed(t) == pb)
+                return true;
+        return false;
+    }
+
     int nrreflections = 1<<size.dim;
 
     Permutation perm(size.dim);
@@ -518,118 +856,3365 @@ void makeallpoints(std::vector<Point>& pts, Size size)
     for (int i=0 ; i<totalpoints ; i++)
         pts.emplace_back(makepoint(size, i));
 }
-/*
- * Generate and print all solutions for a `size` grid with `ncounters` counters.
- */
-void solvegrid(bool printall, int verbose, Size size, int ncounters)
+std::vector<Point> allpoints(Size size)
+{
+    std::vector<Point> pts;
+    makeallpoints(pts, size);
+    return pts;
+}
+
+// the inverse of `makepoint`.
+int encodepoint(Size size, const Point& p)
 {
-    std::vector<Arrangement> solutions;
-    uint64_t i = 0;
-    uint64_t total = generatecombinations::totalcombinations(ncounters, pow(size.width, size.dim));
+    int encodedpoint = 0;
+    for (int i=0 ; i < size.dim ; i++)
+        encodedpoint = encodedpoint*size.width + p[i];
+    return encodedpoint;
+}
 
-    time_t t0 = time(NULL);
 
-    int approxpersecond = 0;
-    uint64_t countu = 0;
+/*
+ * The solver keeps arrangements as the sorted linear indices of their points,
+ * as numbered by `makepoint`. Comparing two of these is comparing two
+ * short integer tuples, coordinates are only decoded for printing.
+ */
+typedef uint16_t PointIndex;
+#define MAXPOINTS 65536
 
-    std::vector<Point> points;
-    makeallpoints(points, size);
+struct IndexArrangement {
+    PointIndex c[MAXCOUNTERS];
+    uint8_t n;
 
-    for (auto& c : generatecombinations(ncounters, pow(size.width, size.dim)))
+    IndexArrangement() : n(0) { }
+
+    static IndexArrangement encode(Size size, const Arrangement& a)
+    {
+        IndexArrangement b;
+        for (auto& p : a)
+            b.add(encodepoint(size, p));
+        return b;
+    }
+    Arrangement decode(Size size) const
     {
         Arrangement a;
-        for (int i = 0 ; i < ncounters ; i++)
-            a.add(points[c[i]]);
-        if (hasuniquedistance(size, a))
-        {
-            countu++;
-            if (!containstransform(size, solutions, a)) {
-                solutions.emplace_back(a);
-                if (printall) {
-                    std::cout << "-----\n";
-                    printarrangement(size, a);
-                }
-            }
+        for (auto ix : *this)
+            a.add(makepoint(size, ix));
+        return a;
+    }
+
+    // insert a point index, keeping the indices sorted.
+    void add(PointIndex ix)
+    {
+        int i = n++;
+        while (i>0 && ix < c[i-1]) {
+            c[i] = c[i-1];
+            i--;
         }
-        i++;
+        c[i] = ix;
+    }
 
-        if (verbose) {
-            if (approxpersecond==0) {
-                time_t t = time(NULL);
-                if (t-t0 > 5) {
-                    approxpersecond = i/(t-t0);
-                    if (approxpersecond<10)
-                        approxpersecond = 1;
-                }
+    PointIndex operator[](int i) const { return c[i]; }
 
-            }
-            if (approxpersecond && (i%approxpersecond)==0) {
-                time_t t = time(NULL);
-                uint64_t apersec = t!=t0 ? i/(t-t0) : 0;
-                uint64_t estimate = apersec ? (total-i) / apersec : 0;
-                std::cout << "Tried " << i << " arrangements, " << apersec << " per second, found " << solutions.size() << " solutions, " << estimate << " seconds to go.\r";
-                std::cout.flush();
-            }
+    const PointIndex*begin() const { return &c[0]; }
+    const PointIndex*end() const { return &c[0]+n; }
+
+    friend std::ostream& operator<<(std::ostream& os, const IndexArrangement& a)
+    {
+        os << '[';
+        for (int i=0 ; i<a.n ; i++) {
+            if (i) os << ",";
+            os << a[i];
         }
+        os << ']';
+        return os;
     }
-    time_t t = time(NULL);
-    std::cout << "\n";
-    std::cout << "Found " << solutions.size() << " solutions in " << total << " total arangements, in " << (t-t0) << " seconds.\n";
-    std::cout << countu << " unique\n";
-}
 
-#ifndef NOMAIN
-int main(int argc, char**argv)
+    friend bool operator==(const IndexArrangement& a, const IndexArrangement& b)
+    {
+        return a.n==b.n && std::equal(a.begin(), a.end(), b.begin());
+    }
+    friend bool operator!=(const IndexArrangement& a, const IndexArrangement& b)
+    {
+        return !(a==b);
+    }
+    friend bool operator<(const IndexArrangement& a, const IndexArrangement& b)
+    {
+        return std::lexicographical_compare(a.begin(), a.end(), b.begin(), b.end());
+    }
+};
+
+
+#define MAXRENDERPOINTS (1<<20)
+
+/*
+ * Output an arrangement in a possibly readable way.
+ *
+ * The grid is drawn with the first coordinate horizontally and the second
+ * vertically. The third selects one of the grids side by side, and for 4 or
+ * more dimensions each combination of the remaining coordinates gets its own
+ * labeled row of grids. The text is built in a buffer from an occupancy map
+ * of the points, and written in one call. Grids of less than 2 or more than
+ * MAXRENDERPOINTS points are listed by their coordinates instead.
+ *
+ * `a` is any sequence of point indices, so this also renders the 64 bit
+ * indices of a WideArrangement.
+ */
+template<typename INDICES>
+void renderarrangement(std::string& out, Size size, const INDICES& a)
 {
-    Size size;
-    int ncounters = -1;
-    size.width = 3;
-    size.dim = 2;
+    uint64_t npoints = 1;
+    for (int k=0 ; k<size.dim && npoints<=MAXRENDERPOINTS ; k++)
+        npoints *= size.width;
 
-    int verbose = 0;
-    bool printall = false;
+    // appends the coordinates of `ix` in the `dim` dimensional grid.
+    auto coords = [&](uint64_t ix, int dim, bool first) {
+        std::vector<uint64_t> x(dim);
+        for (int k=dim-1 ; k>=0 ; k--) {
+            x[k] = ix % size.width;
+            ix /= size.width;
+        }
+        for (auto v : x) {
+            if (!first) out += ',';
+            out += std::to_string(v);
+            first = false;
+        }
+    };
 
-    while (argc>=2 && argv[1][0]=='-') {
-        if (argv[1][1] == 'p') {
-            printall = true;
-            argv++; argc--;
+    if (size.dim < 2 || npoints > MAXRENDERPOINTS) {
+        out += '{';
+        bool first = true;
+        for (auto ix : a) {
+            if (!first) out += ", ";
+            out += '(';
+            coords(ix, size.dim, true);
+            out += ')';
+            first = false;
         }
-        else if (argv[1][1] == 'v') {
-            verbose = strlen(argv[1])-1;
-            argv++; argc--;
+        out += "}\n";
+        return;
+    }
+
+    int w = size.width;
+    std::vector<char> occupied(npoints);
+    for (auto ix : a)
+        occupied[ix] = 1;
+
+    int depth = size.dim == 2 ? 1 : w;          // grids side by side.
+    uint64_t nslices = npoints / (uint64_t(w)*w*depth);
+    for (uint64_t slice = 0 ; slice < nslices ; slice++) {
+        if (size.dim > 3) {
+            out += "(.,.,.";
+            coords(slice, size.dim-3, false);
+            out += ")\n";
         }
-        else {
-            std::cout << "Usage: " << argv[0] << " [-p] [-v] [width [dimension [ncounters]]]\n";
-            return 0;
+        for (int y = 0 ; y < w ; y++) {
+            for (int z = 0 ; z < depth ; z++) {
+                for (int x = 0 ; x < w ; x++)
+                    out += occupied[((uint64_t(x)*w + y)*depth + z)*nslices + slice] ? '*' : '.';
+                if (size.dim > 2)
+                    out += "  ";
+            }
+            out += '\n';
         }
+        out += '\n';
     }
+}
 
-    if (argc>=2)
-        size.width = strtol(argv[1], 0, 0);
+void printarrangement(Size size, const IndexArrangement& a)
+{
+    std::string out;
+    renderarrangement(out, size, a);
+    std::cout.write(out.data(), out.size());
+}
 
-    if (argc>=3)
-        size.dim = strtol(argv[2], 0, 0);
-    if (argc>=4)
-        ncounters = strtol(argv[3], 0, 0);
-    if (ncounters==-1)
-        ncounters = size.width;
+void printarrangement(Size size, const Arrangement& a)
+{
+    printarrangement(size, IndexArrangement::encode(size, a));
+}
 
-    if (size.dim > MAXDIM) {
-        std::cout << "max dimensions is: " << MAXDIM << "\n";
-        return 1;
-    }
-    if (ncounters > MAXCOUNTERS) {
-        std::cout << "max counters is: " << MAXCOUNTERS << "\n";
-        return 1;
+/*
+ * A file mapped read-only into memory.
+ */
+struct MappedFile {
+    const uint8_t *data;
+    size_t size;
+
+    MappedFile() : data(nullptr), size(0) { }
+    ~MappedFile() { close(); }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // returns false when the file can not be mapped, or is smaller than `minsize`.
+    bool open(const char *path, size_t minsize)
+    {
+        close();
+        int fd = ::open(path, O_RDONLY);
+        if (fd == -1)
+            return false;
+        struct stat st;
+        void *map = MAP_FAILED;
+        if (fstat(fd, &st) == 0 && size_t(st.st_size) >= minsize && st.st_size > 0)
+            map = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (map == MAP_FAILED)
+            return false;
+        data = (const uint8_t*)map;
+        size = st.st_size;
+        return true;
     }
-    if ( pow(size.width-1, size.dim)*size.dim > FixedSet::maxsize()) {
-        std::cout << "max set size is: " << FixedSet::maxsize() << "\n";
-        return 1;
+    void close()
+    {
+        if (data)
+            munmap((void*)data, size);
+        data = nullptr;
+        size = 0;
     }
-    if ( size.dim * log(size.width) >= 31 * log(2) ) {
-        std::cout << "WARNING: integer overflow may make this incorrect\n";
+};
+
+/*
+ * A read-only view of an array, owned elsewhere.
+ */
+template<typename T>
+struct TableView {
+    const T *data;
+    size_t count;
+
+    TableView() : data(nullptr), count(0) { }
+    TableView(const T *data, size_t count) : data(data), count(count) { }
+
+    const T *begin() const { return data; }
+    const T *end() const { return data+count; }
+    size_t size() const { return count; }
+    bool empty() const { return count==0; }
+    const T& operator[](size_t i) const { return data[i]; }
+};
+
+/*
+ * Cached per-grid tables.
+ *
+ * The tables of GridSymmetry take long to build for high dimensions, 8 dimensions
+ * have over 10 million transforms, so they can be kept in a cache directory.
+ * A cache file holds the header, the transforms and the packed points, and
+ * is mapped read-only, so all processes on one grid share it in the page cache.
+ */
+#define GRIDTABLES_MAGIC "mpmp7tab"
+#define GRIDTABLES_VERSION 1
+
+struct GridTablesHeader {
+    char magic[8];
+    uint32_t version;        // GRIDTABLES_VERSION
+    uint32_t width;
+    uint32_t dim;
+    uint32_t transformsize;  // sizeof(PackedTransform) of the writer.
+    uint64_t ntransforms;
+    uint64_t npoints;
+    uint64_t reserved[3];
+};
+static_assert(sizeof(GridTablesHeader)==64, "the tables header is 64 bytes");
+static_assert(std::is_trivially_copyable<PackedTransform>::value && std::is_trivially_copyable<PackedPoint>::value,
+              "tables are stored as raw bytes");
+
+struct GridTables {
+    std::vector<PackedTransform> owntransforms;
+    std::vector<PackedPoint> ownpacked;
+    MappedFile file;
+
+    TableView<PackedTransform> transforms;
+    TableView<PackedPoint> packed;   // the PackedPoint for each point index.
+
+    /*
+     * Map the tables for `size` from `cachedir`, or build them, and then
+     * add them to the cache. Grids which can not be packed have no tables.
+     */
+    GridTables(Size size, const char *cachedir)
+    {
+        if (!PackedPoint::fits(size))
+            return;
+        std::string path;
+        if (cachedir) {
+            path = std::string(cachedir) + "/mpmp7-tables-" + std::to_string(size.width) + "-" + std::to_string(size.dim)
+                 + "-v" + std::to_string(GRIDTABLES_VERSION);
+            if (load(path.c_str(), size))
+                return;
+        }
+
+        owntransforms = packedtransforms(size);
+        for (auto& p : allpoints(size))
+            ownpacked.emplace_back(p);
+
+        if (cachedir && save(path, size) && load(path.c_str(), size)) {
+            std::vector<PackedTransform>().swap(owntransforms);
+            std::vector<PackedPoint>().swap(ownpacked);
+            return;
+        }
+        transforms = TableView<PackedTransform>(owntransforms.data(), owntransforms.size());
+        packed = TableView<PackedPoint>(ownpacked.data(), ownpacked.size());
+    }
+    GridTables(const GridTables&) = delete;
+    GridTables& operator=(const GridTables&) = delete;
+
+    // map a cache file, returns false when it is missing, or not for this grid and version.
+    bool load(const char *path, Size size)
+    {
+        if (!file.open(path, sizeof(GridTablesHeader)))
+            return false;
+        auto header = (const GridTablesHeader*)file.data;
+        if (memcmp(header->magic, GRIDTABLES_MAGIC, 8) != 0 || header->version != GRIDTABLES_VERSION
+                || header->width != uint32_t(size.width) || header->dim != uint32_t(size.dim)
+                || header->transformsize != sizeof(PackedTransform)
+                || header->npoints != uint64_t(pow(size.width, size.dim))
+                || file.size != sizeof(GridTablesHeader) + header->ntransforms*sizeof(PackedTransform) + header->npoints*sizeof(PackedPoint)) {
+            file.close();
+            return false;
+        }
+        transforms = TableView<PackedTransform>((const PackedTransform*)(header+1), header->ntransforms);
+        packed = TableView<PackedPoint>((const PackedPoint*)(transforms.end()), header->npoints);
+        return true;
+    }
+
+    /*
+     * Write the tables to a temporary file which is then renamed, so
+     * processes starting at the same time never map a partial file.
+     */
+    bool save(const std::string& path, Size size) const
+    {
+        std::string tmppath = path + "-XXXXXX";
+        int fd = mkstemp(&tmppath[0]);
+        if (fd == -1)
+            return false;
+        fchmod(fd, 0644);  // mkstemp makes it private, the cache is shared.
+        ::close(fd);
+
+        GridTablesHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, GRIDTABLES_MAGIC, 8);
+        header.version = GRIDTABLES_VERSION;
+        header.width = size.width;
+        header.dim = size.dim;
+        header.transformsize = sizeof(PackedTransform);
+        header.ntransforms = owntransforms.size();
+        header.npoints = ownpacked.size();
+
+        std::ofstream os(tmppath, std::ios::binary);
+        os.write((const char*)&header, sizeof(header));
+        os.write((const char*)owntransforms.data(), owntransforms.size()*sizeof(PackedTransform));
+        os.write((const char*)ownpacked.data(), ownpacked.size()*sizeof(PackedPoint));
+        os.close();
+        if (!os || rename(tmppath.c_str(), path.c_str()) != 0) {
+            unlink(tmppath.c_str());
+            return false;
+        }
+        return true;
+    }
+};
+
+/*
+ * The rotations and reflections of a grid, applied to IndexArrangements.
+ *
+ * Each equivalence class is represented by its canonical arrangement: the
+ * smallest of all its rotated and reflected images. When the points fit in
+ * a PackedPoint the images are built as PackedArrangements, otherwise from
+ * decoded Arrangements.
+ */
+struct GridSymmetry {
+    Size size;
+    std::shared_ptr<const GridTables> tables;
+    TableView<PackedTransform> transforms;
+    TableView<PackedPoint> packed;   // the PackedPoint for each point index.
+
+    // `cachedir`: where to cache the tables, or null.
+    GridSymmetry(Size size, const char *cachedir = nullptr)
+        : size(size), tables(std::make_shared<GridTables>(size, cachedir)),
+          transforms(tables->transforms), packed(tables->packed)
+    {
+    }
+
+    PackedArrangement pack(const IndexArrangement& a) const
+    {
+        PackedArrangement pa;
+        for (auto ix : a)
+            pa.add(packed[ix]);
+        return pa;
+    }
+    IndexArrangement unpack(const PackedArrangement& pa) const
+    {
+        IndexArrangement a;
+        for (auto p : pa) {
+            int ix = 0;
+            for (int i=0 ; i<size.dim ; i++)
+                ix = ix*size.width + p[i];
+            a.add(ix);
+        }
+        return a;
+    }
+
+    ALWAYS_INLINE IndexArrangement canonicalkernel(const IndexArrangement& a) const
+    {
+        PackedArrangement pa = pack(a);
+        PackedArrangement best = pa;
+        for (auto& t : transforms) {
+            PackedArrangement image = pa.transformed(t);
+            if (image < best)
+                best = image;
+        }
+        return unpack(best);
+    }
+    TARGET_AVX2 IndexArrangement canonical_avx2(const IndexArrangement& a) const
+    {
+        return canonicalkernel(a);
+    }
+    TARGET_AVX512 IndexArrangement canonical_avx512(const IndexArrangement& a) const
+    {
+        return canonicalkernel(a);
+    }
+
+    /*
+     *  The canonical arrangement of the class of `a`, two arrangements are
+     *  rotations or reflections of each other when their canonical forms are equal.
+     */
+    IndexArrangement canonical(int kernel, const IndexArrangement& a) const
+    {
+        if (packed.empty()) {
+            Arrangement da = a.decode(size);
+            IndexArrangement best = a;
+
+            Permutation perm(size.dim);
+            for (int flip = 0 ; flip < (1<<size.dim) ; flip++) {
+                do {
+                    auto image = IndexArrangement::encode(size, rotatearrangement(size, flip, perm, da));
+                    if (image < best)
+                        best = image;
+                } while (perm.next());
+            }
+            return best;
+        }
+        switch (kernel) {
+            case KERNEL_AVX2: return canonical_avx2(a);
+            case KERNEL_AVX512: return canonical_avx512(a);
+        }
+        return canonicalkernel(a);
+    }
+};
+
+/*
+ * A set of solutions, stored as their canonical IndexArrangements.
+ *
+ * The records are `n` point indices each, back to back in one contiguous
+ * arena, with an open addressing hash table of record numbers for lookups.
+ * A record takes 2*n bytes, plus 8 or fewer bytes in the hash table.
+ */
+struct SolutionStore {
+    int n;
+    uint64_t count;
+    std::vector<PointIndex> arena;
+    std::vector<uint32_t> slots;    // record number + 1, or 0 for an empty slot.
+
+    explicit SolutionStore(int n)
+        : n(n), count(0), slots(64)
+    {
+    }
+
+    uint64_t size() const { return count; }
+    bool empty() const { return count==0; }
+    uint64_t memoryused() const { return arena.capacity()*sizeof(PointIndex) + slots.size()*sizeof(uint32_t); }
+
+    void clear()
+    {
+        count = 0;
+        std::vector<PointIndex>().swap(arena);
+        slots.assign(64, 0);
+    }
+
+    const PointIndex *record(uint64_t i) const { return arena.data() + i*n; }
+    IndexArrangement operator[](uint64_t i) const
+    {
+        IndexArrangement a;
+        for (int j=0 ; j<n ; j++)
+            a.add(record(i)[j]);
+        return a;
+    }
+
+    static uint64_t hash(const PointIndex *c, int n)
+    {
+        uint64_t h = 0x9E3779B97F4A7C15;
+        for (int i=0 ; i<n ; i++)
+            h = (h ^ c[i]) * 0xFF51AFD7ED558CCD;
+        return h ^ (h >> 29);
+    }
+
+    // the slot holding `c`, or the empty slot where it would go.
+    uint64_t findslot(const PointIndex *c) const
+    {
+        uint64_t mask = slots.size()-1;
+        for (uint64_t i = hash(c, n) & mask ; ; i = (i+1) & mask) {
+            if (slots[i]==0 || std::equal(c, c+n, record(slots[i]-1)))
+                return i;
+        }
+    }
+
+    bool contains(const IndexArrangement& a) const
+    {
+        return slots[findslot(a.begin())] != 0;
+    }
+
+    // add a canonical arrangement, returns false when it was already there.
+    bool insert(const IndexArrangement& a)
+    {
+        uint64_t i = findslot(a.begin());
+        if (slots[i])
+            return false;
+        arena.insert(arena.end(), a.begin(), a.end());
+        slots[i] = ++count;
+        if (count*2 > slots.size())
+            rehash(slots.size()*2);
+        return true;
+    }
+
+    void rehash(uint64_t nslots)
+    {
+        slots.assign(nslots, 0);
+        for (uint64_t r = 0 ; r < count ; r++)
+            slots[findslot(record(r))] = r+1;
+    }
+
+    /*
+     * Serialization: the record width and count, followed by the arena
+     * in host byte order.
+     */
+    void write(std::ostream& os) const
+    {
+        uint32_t header[2] = { uint32_t(n), 0 };
+        os.write((const char*)header, sizeof(header));
+        os.write((const char*)&count, sizeof(count));
+        os.write((const char*)arena.data(), arena.size()*sizeof(PointIndex));
+    }
+    // replaces the contents with those written by `write`, returns false, and
+    // keeps the contents, for a truncated stream.
+    bool read(std::istream& is)
+    {
+        uint32_t header[2] = { 0, 0 };
+        uint64_t nrecords = 0;
+        is.read((char*)header, sizeof(header));
+        is.read((char*)&nrecords, sizeof(nrecords));
+        if (!is || header[0] > MAXCOUNTERS)
+            return false;
+
+        std::vector<PointIndex> records(nrecords*header[0]);
+        is.read((char*)records.data(), records.size()*sizeof(PointIndex));
+        if (!is)
+            return false;
+        n = header[0];
+        arena.swap(records);
+        count = nrecords;
+        uint64_t nslots = 64;
+        while (nslots < count*2+2)
+            nslots *= 2;
+        rehash(nslots);
+        return true;
+    }
+};
+
+/*
+ * A solution catalog is a binary file: a CatalogHeader, followed by the
+ * canonical IndexArrangements of all solutions, sorted, each record
+ * `n` point indices in host byte order.
+ *
+ * `Catalog` maps such a file read-only, lookups and iteration work
+ * directly on the mapped records without parsing anything.
+ */
+#define CATALOG_MAGIC "mpmp7cat"
+#define CATALOG_VERSION 2
+#define ENGINE_VERSION 1
+
+// which arrangements a catalog counts as the same solution.
+enum { SYMMETRY_NONE, SYMMETRY_ROTATE_REFLECT };
+
+struct CatalogHeader {
+    char magic[8];
+    uint32_t version;     // the CATALOG_VERSION of the file format.
+    uint32_t engine;      // the ENGINE_VERSION of the solver which wrote it.
+    uint32_t width;
+    uint32_t dim;
+    uint32_t n;           // the number of counters.
+    uint32_t symmetry;    // SYMMETRY_xxx
+    uint64_t count;       // the number of records.
+    uint64_t countu;      // the number of arrangements with unique distances.
+    uint64_t blockindex;  // compressed catalogs: the file offset of the block index.
+    uint32_t blocksize;   // compressed catalogs: the number of ranks per block.
+    uint32_t reserved;
+};
+static_assert(sizeof(CatalogHeader)==64, "the catalog header is 64 bytes");
+
+// compare two records of `n` point indices.
+bool recordless(const PointIndex *a, const PointIndex *b, int n)
+{
+    return std::lexicographical_compare(a, a+n, b, b+n);
+}
+
+struct Catalog {
+    MappedFile file;
+    const CatalogHeader *header;
+    const PointIndex *records;
+
+    Catalog() : header(nullptr), records(nullptr) { }
+
+    // map a catalog, returns false when `path` is not a catalog this version can read.
+    bool open(const char *path)
+    {
+        close();
+        if (!file.open(path, sizeof(CatalogHeader)))
+            return false;
+
+        header = (const CatalogHeader*)file.data;
+        records = (const PointIndex*)(header+1);
+
+        if (memcmp(header->magic, CATALOG_MAGIC, sizeof(header->magic)) != 0
+                || header->version != CATALOG_VERSION || header->n > MAXCOUNTERS
+                || file.size != sizeof(CatalogHeader) + header->count*header->n*sizeof(PointIndex)) {
+            close();
+            return false;
+        }
+        return true;
+    }
+    void close()
+    {
+        file.close();
+        header = nullptr;
+        records = nullptr;
+    }
+
+    Size size() const { return Size(header->dim, header->width); }
+    int ncounters() const { return header->n; }
+    uint64_t count() const { return header->count; }
+
+    const PointIndex *record(uint64_t i) const { return records + i*header->n; }
+    IndexArrangement operator[](uint64_t i) const
+    {
+        IndexArrangement a;
+        for (int j=0 ; j<ncounters() ; j++)
+            a.add(record(i)[j]);
+        return a;
+    }
+
+    // the position of the first record not less than `a`.
+    uint64_t lowerbound(const IndexArrangement& a) const
+    {
+        uint64_t lo = 0, hi = count();
+        while (lo < hi) {
+            uint64_t mid = lo + (hi-lo)/2;
+            if (recordless(record(mid), a.begin(), ncounters()))
+                lo = mid+1;
+            else
+                hi = mid;
+        }
+        return lo;
+    }
+    // does the catalog contain the canonical arrangement `a`.
+    bool contains(const IndexArrangement& a) const
+    {
+        if (a.n != ncounters())
+            return false;
+        uint64_t i = lowerbound(a);
+        return i < count() && std::equal(a.begin(), a.end(), record(i));
+    }
+};
+
+/*
+ * The lexicographic rank of a combination: the number of sorted combinations of
+ * a.n out of `npoints` point indices which come before `a`.
+ *
+ * Ranks preserve the order of IndexArrangements, and are exact while
+ * C(npoints, n) fits in a Rank, see `ranksfit`.
+ */
+bool ranksfit(uint64_t npoints, int n)
+{
+    return binomial(npoints, n) != ~Rank(0);
+}
+
+Rank combinationrank(const IndexArrangement& a, int npoints)
+{
+    Rank r = binomial(npoints, a.n) - 1;
+    for (int k=0 ; k<a.n ; k++)
+        r -= binomial(npoints-1-a[k], a.n-k);
+    return r;
+}
+
+IndexArrangement combinationunrank(Rank rank, int n, int npoints)
+{
+    // the combinations after `a` number sum C(npoints-1-a[k], n-k), with
+    // the terms decreasing, so each a[k] can be found greedily.
+    // C(d, n-k) increases with d, so the largest d with C(d, n-k) <= rest is
+    // found by bisection, and C(d, n-k) is 0 for d below n-k.
+    Rank rest = binomial(npoints, n) - 1 - rank;
+    IndexArrangement a;
+    int hi = npoints-1;
+    for (int k=0 ; k<n ; k++) {
+        int lo = n-k-1;
+        while (lo < hi) {
+            int mid = lo + (hi-lo+1)/2;
+            if (binomial(mid, n-k) <= rest)
+                lo = mid;
+            else
+                hi = mid-1;
+        }
+        rest -= binomial(lo, n-k);
+        a.add(npoints-1-lo);
+        hi = lo-1;
+    }
+    return a;
+}
+
+/*
+ * A compressed catalog stores the sorted ranks of the canonical solutions
+ * instead of their point indices. After the CatalogHeader follow blocks of
+ * `blocksize` ranks: the first as a varint, the others as varint deltas
+ * from the previous rank. The block index at the end holds the first rank
+ * and file offset of each block, for seeking, and starts at a multiple of 8 bytes.
+ */
+#define RANKCATALOG_MAGIC "mpmp7crz"
+#define RANKBLOCKSIZE 256
+
+// the rank is split in two, so the block index needs no more than 8 byte alignment.
+struct RankBlock {
+    uint64_t firstlow;
+    uint64_t firsthigh;
+    uint64_t offset;
+
+    RankBlock(Rank first, uint64_t offset) : firstlow(first), firsthigh(first >> 64), offset(offset) { }
+    Rank firstrank() const { return (Rank(firsthigh) << 64) | firstlow; }
+};
+
+// append `v` as a LEB128 varint: 7 bits per byte, the high bit set on all but the last byte.
+void putvarint(std::string& buf, Rank v)
+{
+    while (v >= 0x80) {
+        buf += char(v | 0x80);
+        v >>= 7;
+    }
+    buf += char(v);
+}
+
+// decode a varint, returns nullptr when it runs past `end`.
+const uint8_t *getvarint(const uint8_t *p, const uint8_t *end, Rank& v)
+{
+    v = 0;
+    for (int shift = 0 ; p < end && shift < 128 ; shift += 7) {
+        uint8_t b = *p++;
+        v |= Rank(b & 0x7F) << shift;
+        if (!(b & 0x80))
+            return p;
+    }
+    return nullptr;
+}
+
+struct RankCatalog {
+    MappedFile file;
+    const CatalogHeader *header;
+    const RankBlock *blocks;
+    uint64_t nblocks;
+
+    RankCatalog() : header(nullptr), blocks(nullptr), nblocks(0) { }
+
+    // map a compressed catalog, returns false when `path` is not one this version can read.
+    bool open(const char *path)
+    {
+        close();
+        if (!file.open(path, sizeof(CatalogHeader)))
+            return false;
+        header = (const CatalogHeader*)file.data;
+        if (memcmp(header->magic, RANKCATALOG_MAGIC, sizeof(header->magic)) != 0
+                || header->version != CATALOG_VERSION || header->n > MAXCOUNTERS || header->blocksize == 0) {
+            close();
+            return false;
+        }
+        nblocks = (header->count + header->blocksize - 1) / header->blocksize;
+        if (header->blockindex < sizeof(CatalogHeader) || header->blockindex > file.size
+                || header->blockindex % alignof(RankBlock) != 0
+                || (file.size - header->blockindex) != nblocks*sizeof(RankBlock)) {
+            close();
+            return false;
+        }
+        blocks = (const RankBlock*)(file.data + header->blockindex);
+        return true;
+    }
+    void close()
+    {
+        file.close();
+        header = nullptr;
+        blocks = nullptr;
+        nblocks = 0;
+    }
+
+    Size size() const { return Size(header->dim, header->width); }
+    int ncounters() const { return header->n; }
+    uint64_t count() const { return header->count; }
+    int npoints() const { return pow(int(header->width), int(header->dim)); }
+
+    /*
+     * Decodes the ranks in order, starting at a block.
+     */
+    struct Decoder {
+        const RankCatalog *catalog;
+        const uint8_t *p;
+        uint64_t i;       // the index of the next rank.
+        Rank rank;
+
+        Decoder(const RankCatalog *catalog, uint64_t block)
+            : catalog(catalog), p(nullptr), i(0), rank(0)
+        {
+            if (catalog->header && block < catalog->nblocks) {
+                i = block*catalog->header->blocksize;
+                p = catalog->file.data + catalog->blocks[block].offset;
+            }
+        }
+
+        // decode the next rank, returns false at the end, or for a corrupt block.
+        bool next(Rank& r)
+        {
+            if (!p || i >= catalog->count())
+                return false;
+            Rank v;
+            p = getvarint(p, catalog->file.data + catalog->header->blockindex, v);
+            if (!p)
+                return false;
+            rank = (i % catalog->header->blocksize) ? rank + v : v;
+            i++;
+            r = rank;
+            return true;
+        }
+    };
+    Decoder decoder(uint64_t block = 0) const { return Decoder(this, block); }
+
+    bool containsrank(Rank r) const
+    {
+        // the last block starting at or before `r`.
+        auto b = std::upper_bound(blocks, blocks+nblocks, r, [](Rank r, const RankBlock& b) { return r < b.firstrank(); });
+        if (b == blocks)
+            return false;
+        Decoder d = decoder(b-blocks-1);
+        Rank x;
+        for (int j = 0 ; j < int(header->blocksize) && d.next(x) && x <= r ; j++)
+            if (x == r)
+                return true;
+        return false;
+    }
+    // does the catalog contain the canonical arrangement `a`.
+    bool contains(const IndexArrangement& a) const
+    {
+        return a.n == ncounters() && containsrank(combinationrank(a, npoints()));
+    }
+};
+
+/*
+ * Writes a catalog, plain or compressed, from solutions added in increasing order.
+ */
+struct CatalogWriter {
+    std::ofstream os;
+    CatalogHeader header;
+    bool compress;
+    int npoints;
+    std::vector<RankBlock> index;   // compressed: the blocks written so far.
+    std::string buf;                // compressed: the current block.
+    uint64_t offset;                // compressed: the file offset of the current block.
+    Rank lastrank;
+
+    CatalogWriter() : compress(false), npoints(0), offset(0), lastrank(0) { }
+
+    // fails for a compressed catalog of a grid whose ranks do not fit in 128 bits.
+    bool open(const char *path, Size size, int n, bool compressed)
+    {
+        compress = compressed;
+        npoints = pow(size.width, size.dim);
+        if (compress && !ranksfit(npoints, n))
+            return false;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, compress ? RANKCATALOG_MAGIC : CATALOG_MAGIC, sizeof(header.magic));
+        header.version = CATALOG_VERSION;
+        header.engine = ENGINE_VERSION;
+        header.width = size.width;
+        header.dim = size.dim;
+        header.n = n;
+        header.symmetry = SYMMETRY_ROTATE_REFLECT;
+        header.blocksize = compress ? RANKBLOCKSIZE : 0;
+
+        os.open(path, std::ios::binary);
+        os.write((const char*)&header, sizeof(header));
+        offset = sizeof(header);
+        return bool(os);
+    }
+
+    void add(const IndexArrangement& a)
+    {
+        if (!compress) {
+            os.write((const char*)a.begin(), a.n*sizeof(PointIndex));
+            header.count++;
+        }
+        else {
+            add(combinationrank(a, npoints));
+        }
+    }
+    // add a solution by its rank, for compressed catalogs.
+    void add(Rank rank)
+    {
+        if (header.count % RANKBLOCKSIZE == 0) {
+            flushblock();
+            index.emplace_back(rank, offset);
+            putvarint(buf, rank);
+        }
+        else {
+            putvarint(buf, rank-lastrank);
+        }
+        lastrank = rank;
+        header.count++;
+    }
+    void flushblock()
+    {
+        os.write(buf.data(), buf.size());
+        offset += buf.size();
+        buf.clear();
+    }
+
+    // finish the file, returns false when it could not be written.
+    bool close(uint64_t countu)
+    {
+        header.countu = countu;
+        if (compress) {
+            // the mapped block index must be aligned.
+            buf.resize(buf.size() + (alignof(RankBlock) - (offset+buf.size()) % alignof(RankBlock)) % alignof(RankBlock));
+            flushblock();
+            header.blockindex = offset;
+            os.write((const char*)index.data(), index.size()*sizeof(RankBlock));
+        }
+        os.seekp(0);
+        os.write((const char*)&header, sizeof(header));
+        os.close();
+        return bool(os);
+    }
+};
+
+/*
+ * Write the solutions in `store` as a catalog, returns false when the file could not be written.
+ */
+bool writecatalog(const char *path, Size size, const SolutionStore& store, uint64_t countu, bool compress)
+{
+    std::vector<uint64_t> order(store.size());
+    for (uint64_t i=0 ; i<order.size() ; i++)
+        order[i] = i;
+    std::sort(order.begin(), order.end(), [&](uint64_t a, uint64_t b) {
+        return recordless(store.record(a), store.record(b), store.n);
+    });
+
+    CatalogWriter writer;
+    if (!writer.open(path, size, store.n, compress))
+        return false;
+    for (auto r : order)
+        writer.add(store[r]);
+    return writer.close(countu);
+}
+
+/*
+ * Reads the solutions of either kind of catalog, in increasing order.
+ */
+struct CatalogReader {
+    Catalog catalog;
+    RankCatalog rankcatalog;
+    const CatalogHeader *header;
+    uint64_t i;                   // plain: the next record.
+    RankCatalog::Decoder decoder; // compressed: the next rank.
+
+    CatalogReader() : header(nullptr), i(0), decoder(&rankcatalog, 0) { }
+    CatalogReader(const CatalogReader&) = delete;
+    CatalogReader& operator=(const CatalogReader&) = delete;
+
+    bool open(const char *path)
+    {
+        if (catalog.open(path))
+            header = catalog.header;
+        else if (rankcatalog.open(path)) {
+            header = rankcatalog.header;
+            decoder = rankcatalog.decoder();
+        }
+        return header != nullptr;
+    }
+    bool compressed() const { return rankcatalog.header != nullptr; }
+    Size size() const { return Size(header->dim, header->width); }
+
+    bool next(IndexArrangement& a)
+    {
+        if (!compressed()) {
+            if (i >= catalog.count())
+                return false;
+            a = catalog[i++];
+            return true;
+        }
+        Rank rank;
+        if (!decoder.next(rank))
+            return false;
+        a = combinationunrank(rank, header->n, rankcatalog.npoints());
+        return true;
+    }
+    // the next solution as its rank, without unranking a compressed catalog.
+    bool next(Rank& rank)
+    {
+        if (compressed())
+            return decoder.next(rank);
+        if (i >= catalog.count())
+            return false;
+        rank = combinationrank(catalog[i++], pow(size().width, size().dim));
+        return true;
+    }
+};
+
+/*
+ * Merge the solutions of sorted catalogs, dropping solutions found in several,
+ * calling `visit(a)` for each in increasing order. Returns the number of
+ * distinct solutions. Only the current solution of each input is kept in memory.
+ *
+ * KEY is IndexArrangement, or Rank, which keeps the same order, to merge
+ * compressed catalogs without unranking them.
+ */
+template<typename KEY = IndexArrangement, typename VISIT>
+uint64_t mergeinto(std::vector<std::unique_ptr<CatalogReader>>& readers, VISIT visit)
+{
+    // a heap of the current solution of each reader, smallest on top.
+    typedef std::pair<KEY, int> Entry;
+    auto greater = [](const Entry& a, const Entry& b) { return b.first < a.first; };
+    std::vector<Entry> heap;
+    for (int k=0 ; k<int(readers.size()) ; k++) {
+        KEY a;
+        if (readers[k]->next(a))
+            heap.emplace_back(a, k);
+    }
+    std::make_heap(heap.begin(), heap.end(), greater);
+
+    uint64_t count = 0;
+    KEY last = KEY();
+    while (!heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end(), greater);
+        Entry& e = heap.back();
+        if (count==0 || e.first != last) {
+            visit(e.first);
+            last = e.first;
+            count++;
+        }
+        if (readers[e.second]->next(e.first))
+            std::push_heap(heap.begin(), heap.end(), greater);
+        else
+            heap.pop_back();
+    }
+    return count;
+}
+
+/*
+ * Merge catalogs into `output`, summing the number of unique arrangements.
+ */
+int mergecatalogs(const char *output, bool compress, const std::vector<const char*>& inputs)
+{
+    std::vector<std::unique_ptr<CatalogReader>> readers;
+    uint64_t countu = 0;
+    for (auto path : inputs) {
+        readers.emplace_back(new CatalogReader);
+        auto& r = *readers.back();
+        if (!r.open(path)) {
+            std::cout << "not a catalog: " << path << "\n";
+            return 1;
+        }
+        auto h = readers[0]->header;
+        if (r.header->width != h->width || r.header->dim != h->dim || r.header->n != h->n || r.header->symmetry != h->symmetry) {
+            std::cout << "catalog for a different grid: " << path << "\n";
+            return 1;
+        }
+        countu += r.header->countu;
+    }
+    if (readers.empty()) {
+        std::cout << "nothing to merge\n";
+        return 1;
+    }
+
+    CatalogWriter writer;
+    if (compress && !ranksfit(pow(readers[0]->size().width, readers[0]->size().dim), readers[0]->header->n)) {
+        std::cout << "ranks are limited to 128 bits, can not compress " << output << "\n";
+        return 1;
+    }
+    if (!writer.open(output, readers[0]->size(), readers[0]->header->n, compress)) {
+        std::cout << "could not write catalog " << output << "\n";
+        return 1;
+    }
+    if (compress)
+        mergeinto<Rank>(readers, [&](Rank r) { writer.add(r); });
+    else
+        mergeinto(readers, [&](const IndexArrangement& a) { writer.add(a); });
+    if (!writer.close(countu)) {
+        std::cout << "could not write catalog " << output << "\n";
+        return 1;
+    }
+    std::cout << "Merged " << inputs.size() << " catalogs: " << writer.header.count << " solutions, " << countu << " unique\n";
+    return 0;
+}
+
+/*
+ * Dedup for more solutions than fit in memory: when the SolutionStore grows
+ * beyond `limit` bytes it is written to a sorted run, a plain catalog in
+ * `dir`, and emptied. `finish` merges all runs, removing the duplicates
+ * between them.
+ */
+struct SpilledRuns {
+    Size size;
+    int n;
+    uint64_t limit;
+    std::string dir;
+    std::vector<std::string> runs;
+
+    SpilledRuns(Size size, int n, uint64_t limit, const char *dir)
+        : size(size), n(n), limit(limit), dir(dir)
+    {
+    }
+    ~SpilledRuns()
+    {
+        for (auto& run : runs)
+            unlink(run.c_str());
+    }
+
+    bool full(const SolutionStore& store) const
+    {
+        return limit && store.memoryused() > limit;
+    }
+
+    // write `store` to a new run and clear it, returns false when the run could not be written.
+    bool spill(SolutionStore& store)
+    {
+        std::string path = dir + "/mpmp7-run-XXXXXX";
+        int fd = mkstemp(&path[0]);
+        if (fd == -1)
+            return false;
+        ::close(fd);
+        runs.push_back(path);
+        if (!writecatalog(path.c_str(), size, store, 0, false))
+            return false;
+        store.clear();
+        return true;
+    }
+
+    /*
+     * Merge the runs and the solutions left in `store`, into a catalog at `output`
+     * unless that is null, calling `visit(a)` for each distinct solution.
+     * Returns false when a file could not be written or read back,
+     * `nsolutions` is set to the number of distinct solutions.
+     */
+    template<typename VISIT>
+    bool finish(SolutionStore& store, const char *output, bool compress, uint64_t countu, uint64_t& nsolutions, VISIT visit)
+    {
+        if (!store.empty() && !spill(store))
+            return false;
+
+        std::vector<std::unique_ptr<CatalogReader>> readers;
+        for (auto& run : runs) {
+            readers.emplace_back(new CatalogReader);
+            if (!readers.back()->open(run.c_str()))
+                return false;
+        }
+        CatalogWriter writer;
+        if (output && !writer.open(output, size, n, compress))
+            return false;
+        nsolutions = mergeinto(readers, [&](const IndexArrangement& a) {
+            if (output)
+                writer.add(a);
+            visit(a);
+        });
+        return !output || writer.close(countu);
+    }
+};
+
+/*
+ * The parameters of the grid being searched.
+ *
+ * `Shape` keeps them in runtime variables, `FixedShape` makes them compile time
+ * constants, so all loops over dimensions and counters have constant bounds
+ * and can be fully unrolled.
+ */
+struct Shape {
+    Size grid;
+    int n;
+    int np;
+
+    static constexpr bool fixed = false;
+
+    Shape(Size size, int ncounters)
+        : grid(size), n(ncounters), np(pow(size.width, size.dim))
+    {
+    }
+    Size size() const { return grid; }
+    int dim() const { return grid.dim; }
+    int width() const { return grid.width; }
+    int ncounters() const { return n; }
+    int npoints() const { return np; }
+    int dimconstant() const { return grid.dim; }
+
+    // calls `fn(depth)`.
+    template<typename FN>
+    auto withdepth(int depth, FN fn) const { return fn(depth); }
+};
+
+template<int DIM, int WIDTH, int N>
+struct FixedShape {
+    static constexpr bool fixed = true;
+
+    static Size size() { return Size(DIM, WIDTH); }
+    static constexpr int dim() { return DIM; }
+    static constexpr int width() { return WIDTH; }
+    static constexpr int ncounters() { return N; }
+    static constexpr int npoints() { return pow(WIDTH, DIM); }
+    static constexpr std::integral_constant<int, DIM> dimconstant() { return {}; }
+
+    // calls `fn(depth)`, with `depth` passed as a compile time constant.
+    template<typename FN>
+    static auto withdepth(int depth, FN fn)
+    {
+        return withdepth(depth, fn, std::make_integer_sequence<int, N>());
+    }
+    template<typename FN, int...D>
+    static auto withdepth(int depth, FN fn, std::integer_sequence<int, D...>)
+    {
+        decltype(fn(0)) result {};
+        ((depth==D && (result = fn(std::integral_constant<int, D>()), true)) || ...);
+        return result;
+    }
+};
+
+/*
+ * Calculate the square of the distance between two points in a `shape` grid.
+ */
+template<typename SHAPE>
+int dist2(const SHAPE& shape, const Point& p, const Point& q)
+{
+    int total = 0;
+    for (int i=0 ; i<shape.dim() ; i++)
+        total += square(p[i]-q[i]);
+    return total;
+}
+
+
+/*
+ * The coordinates of all grid points, stored per dimension, so the same
+ * coordinate of consecutive points is adjacent in memory.
+ * This is the layout needed to check LANES candidate points at once.
+ *
+ * Each column is padded with LANES extra entries, so a batch starting
+ * at any point in the grid can be loaded without bounds checks.
+ */
+#define LANES 16
+
+struct PointColumns {
+    int dim;
+    int count;
+    std::vector<int> x[MAXDIM];
+
+    PointColumns(Size size, const std::vector<Point>& pts)
+        : dim(size.dim), count(pts.size())
+    {
+        for (int k=0 ; k<dim ; k++) {
+            x[k].resize(count+LANES);
+            for (int i=0 ; i<count ; i++)
+                x[k][i] = pts[i][k];
+        }
+    }
+    const int *column(int k) const { return x[k].data(); }
+};
+
+/*
+ * Check the LANES candidate points starting at index `first` as the next
+ * counter after the `nprefix` counters in `prefix`, whose distances are in `used`.
+ *
+ * Returns a mask with bit `l` set when candidate `first+l` has only new,
+ * and mutually different, distances to the prefix.
+ * Candidates at or beyond `last` are never valid.
+ *
+ * `dim` and `nprefix` are either an int, or a std::integral_constant, so
+ * the specialized solvers share one kernel per dimension and depth.
+ */
+template<typename DIM, typename NPREFIX>
+uint32_t extensionmask(DIM dim, const PointColumns& cols, const Point* prefix, NPREFIX nprefix, const FixedSet& used, int first, int last)
+{
+    const unsigned int *bits = used.bits;
+
+    int ok[LANES];
+    for (int l=0 ; l<LANES ; l++)
+        ok[l] = first+l < last;
+
+    int d[MAXCOUNTERS][LANES];
+    for (int j=0 ; j<nprefix ; j++) {
+        int *dj = d[j];
+        for (int l=0 ; l<LANES ; l++)
+            dj[l] = 0;
+        for (int k=0 ; k<dim ; k++) {
+            const int *x = cols.column(k)+first;
+            int px = prefix[j][k];
+            for (int l=0 ; l<LANES ; l++)
+                dj[l] += square(x[l]-px);
+        }
+
+        for (int l=0 ; l<LANES ; l++)
+            ok[l] &= ~(bits[dj[l]>>5] >> (dj[l]&31)) & 1;
+        for (int i=0 ; i<j ; i++)
+            for (int l=0 ; l<LANES ; l++)
+                ok[l] &= d[i][l] != dj[l];
+
+        // stop as soon as all candidates failed.
+        int any = 0;
+        for (int l=0 ; l<LANES ; l++)
+            any |= ok[l];
+        if (!any)
+            return 0;
+    }
+
+    uint32_t mask = 0;
+    for (int l=0 ; l<LANES ; l++)
+        mask |= uint32_t(ok[l]) << l;
+    return mask;
+}
+
+#ifdef KERNEL_X86
+/*
+ * `extensionmask` with avx2 intrinsics: the LANES candidates are in two
+ * registers of 8, the distance set is read with gathers.
+ */
+template<typename DIM, typename NPREFIX>
+TARGET_AVX2 uint32_t extensionmask_avx2(DIM dim, const PointColumns& cols, const Point* prefix, NPREFIX nprefix, const FixedSet& used, int first, int last)
+{
+    const int *bits = (const int*)used.bits;
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256i low5 = _mm256_set1_epi32(31);
+
+    __m256i ix0 = _mm256_add_epi32(_mm256_set1_epi32(first), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+    __m256i ix1 = _mm256_add_epi32(ix0, _mm256_set1_epi32(8));
+    __m256i ok0 = _mm256_cmpgt_epi32(_mm256_set1_epi32(last), ix0);
+    __m256i ok1 = _mm256_cmpgt_epi32(_mm256_set1_epi32(last), ix1);
+
+    __m256i d0[MAXCOUNTERS], d1[MAXCOUNTERS];
+    for (int j=0 ; j<nprefix ; j++) {
+        __m256i a0 = _mm256_setzero_si256();
+        __m256i a1 = _mm256_setzero_si256();
+        for (int k=0 ; k<dim ; k++) {
+            const int *x = cols.column(k)+first;
+            __m256i px = _mm256_set1_epi32(prefix[j][k]);
+            __m256i t0 = _mm256_sub_epi32(_mm256_loadu_si256((const __m256i*)x), px);
+            __m256i t1 = _mm256_sub_epi32(_mm256_loadu_si256((const __m256i*)(x+8)), px);
+            a0 = _mm256_add_epi32(a0, _mm256_mullo_epi32(t0, t0));
+            a1 = _mm256_add_epi32(a1, _mm256_mullo_epi32(t1, t1));
+        }
+
+        __m256i w0 = _mm256_i32gather_epi32(bits, _mm256_srli_epi32(a0, 5), 4);
+        __m256i w1 = _mm256_i32gather_epi32(bits, _mm256_srli_epi32(a1, 5), 4);
+        w0 = _mm256_and_si256(_mm256_srlv_epi32(w0, _mm256_and_si256(a0, low5)), one);
+        w1 = _mm256_and_si256(_mm256_srlv_epi32(w1, _mm256_and_si256(a1, low5)), one);
+        ok0 = _mm256_andnot_si256(_mm256_cmpeq_epi32(w0, one), ok0);
+        ok1 = _mm256_andnot_si256(_mm256_cmpeq_epi32(w1, one), ok1);
+
+        for (int i=0 ; i<j ; i++) {
+            ok0 = _mm256_andnot_si256(_mm256_cmpeq_epi32(d0[i], a0), ok0);
+            ok1 = _mm256_andnot_si256(_mm256_cmpeq_epi32(d1[i], a1), ok1);
+        }
+        if (_mm256_testz_si256(_mm256_or_si256(ok0, ok1), _mm256_or_si256(ok0, ok1)))
+            return 0;
+        d0[j] = a0;
+        d1[j] = a1;
+    }
+    return _mm256_movemask_ps(_mm256_castsi256_ps(ok0)) | (_mm256_movemask_ps(_mm256_castsi256_ps(ok1)) << 8);
+}
+
+/*
+ * `extensionmask` with avx512 intrinsics: all LANES candidates are in one
+ * register, and only the candidates still valid are gathered.
+ */
+template<typename DIM, typename NPREFIX>
+TARGET_AVX512 uint32_t extensionmask_avx512(DIM dim, const PointColumns& cols, const Point* prefix, NPREFIX nprefix, const FixedSet& used, int first, int last)
+{
+    const int *bits = (const int*)used.bits;
+    const __m512i one = _mm512_set1_epi32(1);
+    const __m512i low5 = _mm512_set1_epi32(31);
+
+    __m512i ix = _mm512_add_epi32(_mm512_set1_epi32(first), _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15));
+    __mmask16 ok = _mm512_cmpgt_epi32_mask(_mm512_set1_epi32(last), ix);
+
+    __m512i d[MAXCOUNTERS];
+    for (int j=0 ; j<nprefix ; j++) {
+        __m512i a = _mm512_setzero_si512();
+        for (int k=0 ; k<dim ; k++) {
+            __m512i t = _mm512_sub_epi32(_mm512_loadu_si512(cols.column(k)+first), _mm512_set1_epi32(prefix[j][k]));
+            a = _mm512_add_epi32(a, _mm512_mullo_epi32(t, t));
+        }
+
+        __m512i w = _mm512_mask_i32gather_epi32(_mm512_setzero_si512(), ok, _mm512_srli_epi32(a, 5), bits, 4);
+        ok &= ~_mm512_test_epi32_mask(_mm512_srlv_epi32(w, _mm512_and_si512(a, low5)), one);
+
+        for (int i=0 ; i<j ; i++)
+            ok &= _mm512_cmpneq_epi32_mask(d[i], a);
+        if (!ok)
+            return 0;
+        d[j] = a;
+    }
+    return ok;
+}
+#endif
+
+/*
+ * Select the `extensionmask` for a kernel instruction set.
+ */
+template<typename DIM, typename NPREFIX>
+struct ExtensionKernel {
+    static uint32_t run(int kernel, DIM dim, const PointColumns& cols, const Point* prefix, NPREFIX nprefix, const FixedSet& used, int first, int last)
+    {
+        switch (kernel) {
+#ifdef KERNEL_X86
+            case KERNEL_AVX2: return extensionmask_avx2(dim, cols, prefix, nprefix, used, first, last);
+            case KERNEL_AVX512: return extensionmask_avx512(dim, cols, prefix, nprefix, used, first, last);
+#endif
+        }
+        return extensionmask(dim, cols, prefix, nprefix, used, first, last);
+    }
+};
+
+/*
+ * The cumulative time of the phases of a search, in time stamp counter cycles.
+ *
+ * Reading the counter costs about as much as checking a batch of candidates,
+ * so only every PHASESAMPLE'th call of a phase is timed, and scaled up by
+ * the number of calls. The first call, which is slow while caches are cold,
+ * is not sampled, and when the scaled up times add up to more than the whole
+ * search they are scaled down to fit. Enumeration, the search itself, is the
+ * remaining time.
+ * Progress is reported by another thread, see SearchProgress.
+ */
+enum { PHASE_ENUMERATE, PHASE_DISTANCES, PHASE_DEDUP, PHASE_OUTPUT, NPHASES };
+#define PHASESAMPLE 64
+
+const char *phasename(int phase)
+{
+    static const char *names[NPHASES] = { "enumeration", "distances", "dedup", "output" };
+    return names[phase];
+}
+
+struct PhaseTimers {
+    uint64_t cycles[NPHASES];  // of the timed calls.
+    uint64_t calls[NPHASES];
+    uint64_t timed[NPHASES];
+    uint64_t total;            // the cycles of the whole search.
+    double seconds;            // the wall clock time of the whole search.
+
+    PhaseTimers() : cycles(), calls(), timed(), total(0), seconds(0) { }
+
+    // the start of a call of `phase`, or 0 when this call is not sampled.
+    uint64_t start(int phase)
+    {
+        return calls[phase]++ % PHASESAMPLE == PHASESAMPLE/2 ? readtsc() : 0;
+    }
+    void stop(int phase, uint64_t t0)
+    {
+        if (t0) {
+            cycles[phase] += readtsc()-t0;
+            timed[phase]++;
+        }
+    }
+    // for rare calls, which are all timed.
+    void add(int phase, uint64_t t0)
+    {
+        calls[phase]++;
+        timed[phase]++;
+        cycles[phase] += readtsc()-t0;
+    }
+
+    // the estimated cycles spent in `phase`.
+    double estimate(int phase) const
+    {
+        double scaled[NPHASES] = { }, sum = 0;
+        for (int p=1 ; p<NPHASES ; p++) {
+            scaled[p] = timed[p] ? double(cycles[p])*calls[p]/timed[p] : 0;
+            sum += scaled[p];
+        }
+        double fit = sum > total ? total/sum : 1;
+        if (phase == PHASE_ENUMERATE)
+            return std::max(total - sum*fit, 0.0);
+        return scaled[phase]*fit;
+    }
+
+    // the estimated wall clock seconds spent in `phase`.
+    double phaseseconds(int phase) const
+    {
+        return total ? estimate(phase)/total*seconds : 0;
+    }
+
+    void print(std::ostream& os) const
+    {
+        if (!total)
+            return;
+        os << "Time in";
+        for (int p=0 ; p<NPHASES ; p++) {
+            os << (p ? ", " : " ") << phasename(p) << " " << std::fixed << std::setprecision(3) << phaseseconds(p) << "s ("
+               << std::setprecision(1) << 100*estimate(p)/total << "%)";
+        }
+        os << std::defaultfloat << ".\n";
+    }
+};
+
+/*
+ * Search statistics for each depth, the number of counters placed before the candidate.
+ *
+ * Candidates are pruned when a distance to the prefix is already used ( collision ),
+ * when the candidate is on a bisector of two prefix counters, with equal distances
+ * to both ( isosceles ), when too few points follow it to place the other counters
+ * ( bound ), when another shard searches it, or at the last depth when its class
+ * was already found ( symmetry ).
+ *
+ * Each search keeps its own statistics, so threads never share them, and they are merged with +=.
+ */
+enum { PRUNE_COLLISION, PRUNE_ISOSCELES, PRUNE_BOUND, PRUNE_SHARD, PRUNE_SYMMETRY, NPRUNE };
+
+const char *prunename(int rule)
+{
+    static const char *names[NPRUNE] = { "collision", "isosceles", "bound", "shard", "symmetry" };
+    return names[rule];
+}
+
+enum { STATS_NONE, STATS_TEXT, STATS_JSON };
+
+struct DepthStats {
+    uint64_t candidates;      // points tried for the counter at this depth.
+    uint64_t nodes;           // prefixes with unique distances visited.
+    uint64_t pruned[NPRUNE];
+    uint64_t solutions;       // new classes found.
+
+    DepthStats() : candidates(0), nodes(0), pruned(), solutions(0) { }
+
+    DepthStats& operator+=(const DepthStats& rhs)
+    {
+        candidates += rhs.candidates;
+        nodes += rhs.nodes;
+        for (int r=0 ; r<NPRUNE ; r++)
+            pruned[r] += rhs.pruned[r];
+        solutions += rhs.solutions;
+        return *this;
+    }
+};
+
+struct SearchStats {
+    std::vector<DepthStats> depths;
+
+    SearchStats& operator+=(const SearchStats& rhs)
+    {
+        depths.resize(std::max(depths.size(), rhs.depths.size()));
+        for (size_t d=0 ; d<rhs.depths.size() ; d++)
+            depths[d] += rhs.depths[d];
+        return *this;
+    }
+
+    void print(std::ostream& os) const
+    {
+        os << "depth   candidates        nodes";
+        for (int r=0 ; r<NPRUNE ; r++)
+            os << std::string(13-strlen(prunename(r)), ' ') << prunename(r);
+        os << "    solutions\n";
+        for (size_t d=0 ; d<depths.size() ; d++) {
+            auto& s = depths[d];
+            os << std::string(5-std::to_string(d).size(), ' ') << d;
+            for (auto v : { s.candidates, s.nodes, s.pruned[0], s.pruned[1], s.pruned[2], s.pruned[3], s.pruned[4], s.solutions }) {
+                std::string str = std::to_string(v);
+                os << std::string(str.size()<13 ? 13-str.size() : 1, ' ') << str;
+            }
+            os << "\n";
+        }
+    }
+
+    // a single line of JSON, with the time in each of the `phases`.
+    void printjson(std::ostream& os, const PhaseTimers& phases) const
+    {
+        os << "{\"stats\":[";
+        for (size_t d=0 ; d<depths.size() ; d++) {
+            auto& s = depths[d];
+            os << (d ? "," : "") << "{\"depth\":" << d << ",\"candidates\":" << s.candidates << ",\"nodes\":" << s.nodes;
+            for (int r=0 ; r<NPRUNE ; r++)
+                os << ",\"" << prunename(r) << "\":" << s.pruned[r];
+            os << ",\"solutions\":" << s.solutions << "}";
+        }
+        os << "],\"phases\":{" << std::fixed << std::setprecision(6);
+        for (int p=0 ; p<NPHASES ; p++)
+            os << (p ? "," : "") << "\"" << phasename(p) << "\":" << phases.phaseseconds(p);
+        os << std::defaultfloat << "}}\n";
+    }
+};
+
+/*
+ * The progress of a running search.
+ *
+ * The search publishes the point indices of its current prefix, and its counts,
+ * with relaxed atomic stores, which are plain stores. A ProgressReporter thread
+ * reads them and works out the coverage. So the search never waits, nor calls
+ * time functions, and needs no calibration.
+ */
+#define PROGRESSDEPTH 16
+
+struct SearchProgress {
+    uint64_t npoints;
+    int ncounters;
+    std::atomic<uint64_t> prefix[PROGRESSDEPTH];  // the current prefix, while the indices increase.
+    std::atomic<uint64_t> nodes;
+    std::atomic<uint64_t> countu;
+    std::atomic<uint64_t> solutions;
+    std::atomic<bool> finished;
+
+    SearchProgress() : npoints(0), ncounters(0), prefix(), nodes(0), countu(0), solutions(0), finished(false) { }
+
+    // set the grid, before any reporter reads the progress.
+    void start(uint64_t points, int counters)
+    {
+        npoints = points;
+        ncounters = counters;
+    }
+
+    // the writers are single threaded, so no read-modify-write is needed.
+    static void set(std::atomic<uint64_t>& a, uint64_t v) { a.store(v, std::memory_order_relaxed); }
+    static uint64_t get(const std::atomic<uint64_t>& a) { return a.load(std::memory_order_relaxed); }
+
+    // the search is at `ix` at `depth`, with `nodes` visited. The index one
+    // deeper is left from the previous subtree, and cleared until it is published.
+    void publish(int depth, uint64_t ix, uint64_t visited)
+    {
+        if (depth < PROGRESSDEPTH)
+            set(prefix[depth], ix);
+        if (depth+1 < PROGRESSDEPTH)
+            set(prefix[depth+1], ~uint64_t(0));
+        set(nodes, visited);
+    }
+
+    /*
+     * The fraction of all arrangements, in lexicographical order, before the
+     * current prefix. The combinations whose counter `d` lies between the
+     * counters d-1 and d of the prefix are C(npoints-1-c[d-1], n-d) - C(npoints-c[d], n-d).
+     * The prefix can be read while it changes, which only makes this less exact,
+     * the reporter never lets the coverage go back.
+     */
+    double coverage() const
+    {
+        if (finished.load(std::memory_order_relaxed))
+            return 1;
+        if (ncounters == 0 || uint64_t(ncounters) > npoints)
+            return 0;
+        // lgamma_r, as lgamma sets the global signgam, and several reporters may run.
+        auto loggamma = [](double x) { int sign; return lgamma_r(x, &sign); };
+        auto logbinomial = [&](double n, double k) { return n<k ? -HUGE_VAL : loggamma(n+1) - loggamma(k+1) - loggamma(n-k+1); };
+        double all = logbinomial(npoints, ncounters);
+        double before = 0;
+        int64_t previous = -1;
+        for (int d=0 ; d < std::min(ncounters, PROGRESSDEPTH) ; d++) {
+            uint64_t c = get(prefix[d]);
+            if (int64_t(c) <= previous || c >= npoints)
+                break;
+            before += exp(logbinomial(npoints-1-previous, ncounters-d) - all) - exp(logbinomial(npoints-c, ncounters-d) - all);
+            previous = c;
+        }
+        return std::min(std::max(before, 0.0), 1.0);
+    }
+};
+
+// a duration as 1h02m03s.
+std::string formatduration(double seconds)
+{
+    if (!(seconds < 1e9))
+        return "?";
+    uint64_t t = seconds;
+    char buf[64];
+    if (t >= 86400)
+        snprintf(buf, sizeof(buf), "%dd%02dh%02dm", int(t/86400), int(t/3600%24), int(t/60%60));
+    else if (t >= 3600)
+        snprintf(buf, sizeof(buf), "%dh%02dm%02ds", int(t/3600), int(t/60%60), int(t%60));
+    else if (t >= 60)
+        snprintf(buf, sizeof(buf), "%dm%02ds", int(t/60), int(t%60));
+    else
+        snprintf(buf, sizeof(buf), "%ds", int(t));
+    return buf;
+}
+
+/*
+ * A thread reporting the progress of a search every `interval` seconds.
+ *
+ * The rate is the growth of the coverage, smoothed with an exponential
+ * moving average, so the estimate follows the search as it moves through
+ * parts of the tree which prune more or less.
+ *
+ * The report is either a line on `os`, overwritten by the next one, or, when
+ * `fd` is not -1, a JSON record per line written to `fd` with a single write,
+ * so that a job scheduler can follow it. The JSON report ends with a record
+ * with "finished", after the search has stopped.
+ */
+struct ProgressReporter {
+    const SearchProgress& progress;
+    std::ostream *os;
+    int fd;
+    std::string fields;   // extra JSON members identifying the search, like "\"width\":4,".
+    double interval;
+    std::chrono::steady_clock::time_point t0;
+
+    double rate;          // smoothed coverage per second.
+    double lastcoverage, lastt;
+    uint64_t lastnodes;
+
+    std::mutex m;
+    std::condition_variable cv;
+    bool stopping;
+    std::thread thread;
+
+    ProgressReporter(const SearchProgress& progress, std::ostream& os, double interval = 1)
+        : progress(progress), os(&os), fd(-1), interval(interval), t0(std::chrono::steady_clock::now()),
+          rate(0), lastcoverage(0), lastt(0), lastnodes(0), stopping(false), thread(&ProgressReporter::loop, this)
+    {
+    }
+    ProgressReporter(const SearchProgress& progress, int fd, const std::string& fields, double interval = 1)
+        : progress(progress), os(nullptr), fd(fd), fields(fields), interval(interval), t0(std::chrono::steady_clock::now()),
+          rate(0), lastcoverage(0), lastt(0), lastnodes(0), stopping(false), thread(&ProgressReporter::loop, this)
+    {
+    }
+    ~ProgressReporter() { stop(); }
+
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m);
+            stopping = true;
+        }
+        cv.notify_all();
+        if (thread.joinable())
+            thread.join();
+    }
+
+    void loop()
+    {
+        std::unique_lock<std::mutex> lock(m);
+        while (!cv.wait_for(lock, std::chrono::duration<double>(interval), [&]{ return stopping; }))
+            report();
+        if (fd != -1)
+            report();
+    }
+
+    void report()
+    {
+        double t = std::chrono::duration<double>(std::chrono::steady_clock::now()-t0).count();
+        double coverage = std::max(progress.coverage(), lastcoverage);
+        uint64_t nodes = SearchProgress::get(progress.nodes);
+        uint64_t countu = SearchProgress::get(progress.countu);
+        uint64_t solutions = SearchProgress::get(progress.solutions);
+
+        // the first sample sets the rate, later ones move it a quarter of the way.
+        double r = t>lastt ? (coverage-lastcoverage) / (t-lastt) : 0;
+        rate = rate==0 ? r : 0.75*rate + 0.25*r;
+        double eta = coverage>=1 ? 0 : rate>0 ? (1-coverage)/rate : 1e99;
+        double nodespersecond = t>lastt ? (nodes-lastnodes)/(t-lastt) : 0;
+
+        if (fd == -1) {
+            *os << "Searched " << std::fixed << std::setprecision(2) << 100*coverage << "%, "
+                << std::setprecision(0) << nodespersecond << " nodes per second, found "
+                << solutions << " solutions, " << countu << " unique, "
+                << formatduration(t) << " elapsed, about " << formatduration(eta) << " to go.   \r" << std::defaultfloat;
+            os->flush();
+        }
+        else {
+            // the search runs on one thread, which is the only entry of "threads".
+            std::ostringstream json;
+            json << std::fixed << std::setprecision(3)
+                 << "{\"time\":" << std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count()
+                 << ",\"elapsed\":" << t << "," << fields
+                 << "\"coverage\":" << std::setprecision(6) << coverage << ",\"rate\":" << std::setprecision(9) << rate;
+            json << ",\"eta\":";
+            if (eta < 1e9)
+                json << std::setprecision(0) << eta;
+            else
+                json << "null";
+            json << std::setprecision(0) << ",\"nodes\":" << nodes << ",\"nodespersecond\":" << nodespersecond
+                 << ",\"countu\":" << countu << ",\"solutions\":" << solutions
+                 << ",\"threads\":[{\"thread\":0,\"nodes\":" << nodes << ",\"nodespersecond\":" << nodespersecond << ",\"prefix\":[";
+            for (int d=0 ; d < std::min(progress.ncounters-1, PROGRESSDEPTH) && coverage<1 ; d++)
+                json << (d ? "," : "") << SearchProgress::get(progress.prefix[d]);
+            json << "]}],\"finished\":" << (stopping ? "true" : "false") << "}\n";
+
+            std::string line = json.str();
+            for (size_t i = 0 ; i < line.size() ; ) {
+                ssize_t n = ::write(fd, line.data()+i, line.size()-i);
+                if (n <= 0)
+                    break;
+                i += n;
+            }
+        }
+
+        lastcoverage = coverage;
+        lastt = t;
+        lastnodes = nodes;
+    }
+};
+
+/*
+ * Depth-first search for all arrangements with unique distances.
+ *
+ * Arrangements are visited in the same lexicographical order as `generatecombinations`,
+ * but a prefix with a repeated distance is never extended. At each depth the
+ * candidates for the next counter are checked LANES at a time with `extensionmask`.
+ */
+template<typename SHAPE>
+struct GridSearch {
+    SHAPE shape;
+    int kernel;
+    std::vector<Point> points;
+    PointColumns cols;
+    std::unique_ptr<FixedSet> used;  // the distances between the counters in the prefix.
+
+    int c[MAXCOUNTERS];              // point indices of the current prefix.
+    Point prefix[MAXCOUNTERS];
+
+    // only search every `nshards`th subtree at `sharddepth`, starting at `shard`.
+    int shard;
+    int nshards;
+    int sharddepth;
+    uint64_t subtrees;
+
+    uint64_t nodes;                  // the prefixes with unique distances visited, at all depths.
+    SearchStats *stats;              // per depth statistics, or null.
+    PhaseTimers timers;
+    SearchProgress *progress;        // where to publish the position, or null.
+
+    GridSearch(const SHAPE& shape, int kernel = KERNEL_GENERIC)
+        : shape(shape), kernel(kernel), points(allpoints(shape.size())), cols(shape.size(), points),
+          used(new FixedSet(maxdist2(shape.size()))),
+          shard(0), nshards(1), sharddepth(std::min(1, shape.ncounters()-1)), subtrees(0), nodes(0), stats(nullptr), progress(nullptr)
+    {
+    }
+
+    // Calls `found(a)` with the IndexArrangement of each arrangement with unique distances.
+    template<typename FOUND>
+    void run(FOUND found)
+    {
+        if (shape.ncounters()==0)
+            found(IndexArrangement());
+        else if (shape.ncounters()<=shape.npoints())
+            extend(0, 0, found);
+        if (progress)
+            progress->finished = true;
+    }
+
+    template<typename FOUND>
+    void extend(int depth, int first, FOUND& found)
+    {
+        int last = shape.npoints()-(shape.ncounters()-1-depth);
+        if (stats)
+            stats->depths[depth].pruned[PRUNE_BOUND] += shape.npoints()-std::max(first, last);
+        for (int b = first ; b < last ; b += LANES) {
+            uint64_t t = timers.start(PHASE_DISTANCES);
+            uint32_t mask = shape.withdepth(depth, [&](auto nprefix) {
+                using K = ExtensionKernel<decltype(shape.dimconstant()), decltype(nprefix)>;
+                return K::run(kernel, shape.dimconstant(), cols, prefix, nprefix, *used, b, last);
+            });
+            timers.stop(PHASE_DISTANCES, t);
+            if (stats)
+                attribute(depth, b, std::min(b+LANES, last), mask);
+            while (mask) {
+                int ix = b + __builtin_ctz(mask);
+                mask &= mask-1;
+
+                if (depth == sharddepth && (subtrees++ % nshards) != uint64_t(shard)) {
+                    if (stats)
+                        stats->depths[depth].pruned[PRUNE_SHARD]++;
+                    continue;
+                }
+                nodes++;
+                if (stats)
+                    stats->depths[depth].nodes++;
+                c[depth] = ix;
+                prefix[depth] = points[ix];
+                if (depth == shape.ncounters()-1) {
+                    // the indices are increasing, so already sorted.
+                    IndexArrangement a;
+                    for (int i=0 ; i<=depth ; i++)
+                        a.c[i] = c[i];
+                    a.n = depth+1;
+                    found(a);
+                }
+                else {
+                    if (progress)
+                        progress->publish(depth, ix, nodes);
+                    for (int i=0 ; i<depth ; i++)
+                        used->add(dist2(shape, prefix[i], prefix[depth]));
+                    extend(depth+1, ix+1, found);
+                    for (int i=0 ; i<depth ; i++)
+                        used->remove(dist2(shape, prefix[i], prefix[depth]));
+                }
+            }
+        }
+    }
+
+    /*
+     * One of Knuth's random probes: walk from the root towards a leaf, going to
+     * a random child at each node. `children[d]` is set to the number of children
+     * of the node at depth d, and `cycles[d]` to the time finding them took.
+     * Returns the number of counters placed, the leaf is at `ncounters`.
+     */
+    template<typename RNG>
+    int probe(RNG& rng, uint64_t *children, uint64_t *cycles)
+    {
+        std::vector<int> valid;
+        int depth = 0;
+        for ( ; depth < shape.ncounters() ; depth++) {
+            uint64_t t = readtsc();
+            int first = depth ? c[depth-1]+1 : 0;
+            int last = shape.npoints()-(shape.ncounters()-1-depth);
+            valid.clear();
+            for (int b = first ; b < last ; b += LANES) {
+                uint32_t mask = shape.withdepth(depth, [&](auto nprefix) {
+                    using K = ExtensionKernel<decltype(shape.dimconstant()), decltype(nprefix)>;
+                    return K::run(kernel, shape.dimconstant(), cols, prefix, nprefix, *used, b, last);
+                });
+                for ( ; mask ; mask &= mask-1)
+                    valid.push_back(b + __builtin_ctz(mask));
+            }
+            children[depth] = valid.size();
+            cycles[depth] = readtsc()-t;
+            if (valid.empty())
+                break;
+
+            int ix = valid[std::uniform_int_distribution<size_t>(0, valid.size()-1)(rng)];
+            c[depth] = ix;
+            prefix[depth] = points[ix];
+            for (int i=0 ; i<depth ; i++)
+                used->add(dist2(shape, prefix[i], prefix[depth]));
+        }
+        // leave `used` empty for the next probe.
+        for (int k=0 ; k<depth ; k++)
+            for (int i=0 ; i<k ; i++)
+                used->remove(dist2(shape, prefix[i], prefix[k]));
+        return depth;
+    }
+
+    /*
+     * Count why the candidates from `first` to `end` which are not in `mask` were
+     * rejected. This repeats the work of the kernel, so only runs with statistics.
+     */
+    void attribute(int depth, int first, int end, uint32_t mask)
+    {
+        auto& s = stats->depths[depth];
+        s.candidates += end-first;
+        for (int ix = first ; ix < end ; ix++) {
+            if ((mask >> (ix-first)) & 1)
+                continue;
+            int d[MAXCOUNTERS];
+            bool collision = false;
+            for (int j=0 ; j<depth ; j++) {
+                d[j] = dist2(shape, prefix[j], points[ix]);
+                collision |= used->contains(d[j]);
+            }
+            s.pruned[collision ? PRUNE_COLLISION : PRUNE_ISOSCELES]++;
+        }
+    }
+};
+
+
+/*
+ * Machine readable output of solutions, one per line, as JSON objects or as CSV:
+ * the point indices, their coordinates, the indices of the canonical arrangement
+ * and its rank. The rank is a string in JSON, as it may not fit in a double.
+ *
+ * Lines are formatted into chunks, which a separate thread writes, so
+ * a slow pipe only stalls the search once all queued chunks are full.
+ */
+enum { FORMAT_TEXT, FORMAT_JSONL, FORMAT_CSV };
+
+struct SolutionWriter {
+    static constexpr size_t CHUNKSIZE = 64*1024;
+    static constexpr size_t MAXQUEUED = 64;   // chunks waiting for the writer thread.
+
+    int fd;
+    int format;
+    Size size;
+    std::string current;              // the chunk being filled.
+    std::deque<std::string> queue;    // full chunks, oldest first.
+    std::mutex mtx;
+    std::condition_variable changed;
+    bool done;
+    bool failed;                      // a write failed, further output is dropped.
+    std::thread thread;
+
+    SolutionWriter(int fd, int format, Size size)
+        : fd(fd), format(format), size(size), done(false), failed(false)
+    {
+        current.reserve(CHUNKSIZE);
+        if (format == FORMAT_CSV)
+            current += "rank,indices,coordinates,key\n";
+        thread = std::thread([this]() { writeloop(); });
+    }
+    ~SolutionWriter() { close(); }
+
+    static void appendint(std::string& s, uint64_t v)
+    {
+        char buf[24];
+        s.append(buf, std::to_chars(buf, buf+sizeof(buf), v).ptr);
+    }
+    template<typename LIST, typename F>
+    static void appendlist(std::string& s, LIST&& list, char open, char sep, char close, F f)
+    {
+        if (open) s += open;
+        bool first = true;
+        for (auto& x : list) {
+            if (!first) s += sep;
+            first = false;
+            f(x);
+        }
+        if (close) s += close;
+    }
+
+    // add the solution `a`, with canonical arrangement `key`.
+    void add(const IndexArrangement& a, const IndexArrangement& key)
+    {
+        auto index = [&](PointIndex ix) { appendint(current, ix); };
+        std::string rank = tostring(combinationrank(key, pow(size.width, size.dim)));
+        if (format == FORMAT_JSONL) {
+            current += "{\"indices\":";
+            appendlist(current, a, '[', ',', ']', index);
+            current += ",\"coords\":";
+            appendlist(current, a, '[', ',', ']', [&](PointIndex ix) {
+                appendlist(current, makepoint(size, ix), '[', ',', ']', [&](int x) { appendint(current, x); });
+            });
+            current += ",\"key\":";
+            appendlist(current, key, '[', ',', ']', index);
+            current += ",\"rank\":\"" + rank + "\"}\n";
+        }
+        else {
+            current += rank;
+            current += ',';
+            appendlist(current, a, 0, ' ', 0, index);
+            current += ',';
+            appendlist(current, a, 0, ';', 0, [&](PointIndex ix) {
+                appendlist(current, makepoint(size, ix), 0, ' ', 0, [&](int x) { appendint(current, x); });
+            });
+            current += ',';
+            appendlist(current, key, 0, ' ', 0, index);
+            current += '\n';
+        }
+        if (current.size() >= CHUNKSIZE)
+            submit();
+    }
+
+    // queue the current chunk, waiting while the queue is full.
+    void submit()
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        changed.wait(lock, [&]() { return queue.size() < MAXQUEUED || failed; });
+        queue.emplace_back(std::move(current));
+        changed.notify_all();
+        current = std::string();
+        current.reserve(CHUNKSIZE);
+    }
+
+    void writeloop()
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        while (true) {
+            changed.wait(lock, [&]() { return !queue.empty() || done; });
+            if (queue.empty())
+                return;
+            std::string chunk = std::move(queue.front());
+            queue.pop_front();
+            changed.notify_all();
+
+            lock.unlock();
+            bool ok = true;
+            for (size_t i = 0 ; ok && i < chunk.size() ; ) {
+                ssize_t n = ::write(fd, chunk.data()+i, chunk.size()-i);
+                ok = n > 0;
+                i += ok ? n : 0;
+            }
+            lock.lock();
+            if (!ok) {
+                failed = true;
+                queue.clear();
+                changed.notify_all();
+            }
+        }
+    }
+
+    // write all remaining output, returns false when a write failed.
+    bool close()
+    {
+        if (!thread.joinable())
+            return !failed;
+        if (!current.empty())
+            submit();
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            done = true;
+            changed.notify_all();
+        }
+        thread.join();
+        return !failed;
+    }
+};
+
+/*
+ * Options for `solve`.
+ */
+struct SolverOptions {
+    bool printall;   // print each new solution.
+    bool printranks; // print solutions as the rank of their canonical arrangement.
+    int verbose;     // print progress.
+    bool generic;    // never use a specialized solver.
+    int kernel;      // the KERNEL_xxx to use.
+    const char *catalog;  // write the solutions to this catalog file.
+    bool compress;   // write a compressed catalog.
+    int shard;       // search only shard `shard` of `nshards`.
+    int nshards;
+    uint64_t memorylimit;  // spill solutions to disk beyond this many bytes, 0 for no limit.
+    const char *spilldir;  // where to spill.
+    const char *cachedir;  // where to cache the per-grid tables, or null.
+    int nthreads;    // threads for --verify.
+    bool dedup;      // --verify: report duplicate and non canonical solutions.
+    int format;      // FORMAT_xxx, for the solutions printed with -p.
+    int stats;       // STATS_xxx, print search statistics for each depth.
+    SolutionWriter *writer;  // writes the solutions in a machine readable format.
+    SearchProgress *progress;  // where the search publishes its progress, or null.
+    int progressfd;  // write JSON progress records to this fd, or -1.
+    double progressinterval;  // seconds between progress reports.
+
+    SolverOptions()
+        : printall(false), printranks(false), verbose(0), generic(false), kernel(bestkernel()), catalog(nullptr), compress(false),
+          shard(0), nshards(1), memorylimit(0), spilldir("/tmp"), cachedir(nullptr),
+          nthreads(std::max(1u, std::thread::hardware_concurrency())), dedup(false), format(FORMAT_TEXT), stats(STATS_NONE), writer(nullptr), progress(nullptr),
+          progressfd(-1), progressinterval(1)
+    {
+    }
+
+    // where progress and summaries go: stderr when stdout has machine readable solutions.
+    std::ostream& report() const { return format==FORMAT_TEXT ? std::cout : std::cerr; }
+};
+
+/*
+ * The outcome of a `solve` run.
+ */
+struct SolveResult {
+    uint64_t solutions;  // the number of solutions, excluding rotations and reflections.
+    uint64_t countu;     // the number of arrangements with unique distances.
+    uint64_t nodes;      // the number of search tree nodes visited.
+    bool specialized;    // a FixedShape solver was used.
+    bool catalogfailed;  // the catalog, or a spilled run, could not be written.
+    SearchStats stats;   // with SolverOptions::stats.
+    PhaseTimers phases;
+
+    SolveResult() : solutions(0), countu(0), nodes(0), specialized(false), catalogfailed(false) { }
+};
+
+
+/*
+ * Print a solution `a` with canonical arrangement `key`: as a grid,
+ * with -r as the rank of `key`, or through the SolutionWriter.
+ * `out` is the caller's buffer for the grid, reused between solutions.
+ */
+void printsolution(const SolverOptions& opts, Size size, const IndexArrangement& a, const IndexArrangement& key, std::string& out)
+{
+    if (opts.writer) {
+        opts.writer->add(a, key);
+        return;
+    }
+    if (opts.printranks) {
+        std::cout << tostring(combinationrank(key, pow(size.width, size.dim))) << "\n";
+        return;
+    }
+    out = "-----\n";
+    renderarrangement(out, size, a);
+    std::cout.write(out.data(), out.size());
+}
+
+/*
+ * Find all solutions for a `shape` grid, optionally printing them.
+ */
+template<typename SHAPE>
+SolveResult searchgrid(const SHAPE& shape, const SolverOptions& opts)
+{
+    Size size = shape.size();
+    SolutionStore solutions(shape.ncounters());
+    uint64_t countu = 0;
+
+    GridSymmetry symmetry(size, opts.cachedir);
+    SpilledRuns spilled(size, shape.ncounters(), opts.memorylimit, opts.spilldir);
+    bool spillfailed = false;
+    uint64_t spilledsolutions = 0;   // in the runs, an upper bound as classes recur between runs.
+    std::string out;
+
+    SolveResult result;
+    if (opts.stats)
+        result.stats.depths.resize(shape.ncounters());
+
+    GridSearch<SHAPE> search(shape, opts.kernel);
+    search.shard = opts.shard;
+    search.nshards = opts.nshards;
+    search.stats = opts.stats ? &result.stats : nullptr;
+    search.progress = opts.progress;
+    PhaseTimers& timers = search.timers;
+    auto wall0 = std::chrono::steady_clock::now();
+    uint64_t tsc0 = readtsc();
+    search.run(
+        [&](const IndexArrangement& a) {
+            countu++;
+            uint64_t t = timers.start(PHASE_DEDUP);
+            IndexArrangement key = symmetry.canonical(opts.kernel, a);
+            bool isnew = solutions.insert(key);
+            timers.stop(PHASE_DEDUP, t);
+            if (opts.progress) {
+                SearchProgress::set(opts.progress->countu, countu);
+                SearchProgress::set(opts.progress->solutions, spilledsolutions + solutions.size());
+            }
+            if (opts.stats && a.n)
+                (isnew ? result.stats.depths[a.n-1].solutions : result.stats.depths[a.n-1].pruned[PRUNE_SYMMETRY])++;
+            if (isnew) {
+                // once spilled, a class can be found again, so printing waits for the final merge.
+                if (opts.printall && !opts.memorylimit) {
+                    t = timers.start(PHASE_OUTPUT);
+                    printsolution(opts, size, a, key, out);
+                    timers.stop(PHASE_OUTPUT, t);
+                }
+                if (spilled.full(solutions) && !spillfailed) {
+                    t = readtsc();
+                    spilledsolutions += solutions.size();
+                    spillfailed = !spilled.spill(solutions);
+                    timers.add(PHASE_OUTPUT, t);
+                }
+            }
+        });
+    uint64_t tsc = readtsc();
+
+    result.solutions = solutions.size();
+    result.countu = countu;
+    result.nodes = search.nodes;
+    result.specialized = SHAPE::fixed;
+    auto print = [&](const IndexArrangement& a) {
+        if (opts.printall && opts.memorylimit)
+            printsolution(opts, size, a, a, out);
+    };
+    if (!spilled.runs.empty() || spillfailed) {
+        result.catalogfailed = spillfailed || !spilled.finish(solutions, opts.catalog, opts.compress, countu, result.solutions, print);
+        // only the merge knows which classes recurred between runs, take the counts from it.
+        if (!result.catalogfailed && opts.stats && shape.ncounters()) {
+            auto& last = result.stats.depths[shape.ncounters()-1];
+            uint64_t found = last.solutions + last.pruned[PRUNE_SYMMETRY];
+            last.solutions = result.solutions;
+            last.pruned[PRUNE_SYMMETRY] = found - result.solutions;
+        }
+        if (!result.catalogfailed && opts.progress)
+            SearchProgress::set(opts.progress->solutions, result.solutions);
+    }
+    else {
+        for (uint64_t i=0 ; i<solutions.size() ; i++)
+            print(solutions[i]);
+        if (opts.catalog)
+            result.catalogfailed = !writecatalog(opts.catalog, size, solutions, countu, opts.compress);
+    }
+    timers.add(PHASE_OUTPUT, tsc);
+    timers.total = readtsc()-tsc0;
+    timers.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now()-wall0).count();
+    result.phases = timers;
+    return result;
+}
+
+
+/*
+ * Grids beyond the limits of the fixed size types are solved by `searchwide`:
+ * those with more than MAXDIM dimensions, more than MAXCOUNTERS counters,
+ * more than MAXPOINTS points, or distances too large for a FixedSet.
+ *
+ * There coordinates, point indices and distances are 64-bit, and
+ * all arrangements and sets are sized at runtime.
+ */
+int64_t widemaxdist2(Size size)
+{
+    return int64_t(size.dim)*(size.width-1)*(size.width-1);
+}
+
+// can the point indices of this grid be stored in a uint64.
+bool fitswide(Size size)
+{
+    return size.dim * log2(size.width) < 64;
+}
+
+bool needswide(Size size, int ncounters)
+{
+    return size.dim > MAXDIM || ncounters > MAXCOUNTERS
+        || !fitswide(size) || pow(size.width, size.dim) > MAXPOINTS
+        || widemaxdist2(size) >= FixedSet::maxsize();
+}
+
+/*
+ * A set of distances: a bitmap when the largest distance is small enough, a hash set otherwise.
+ */
+struct DistanceSet {
+    std::vector<uint64_t> bits;
+    std::unordered_set<int64_t> hashed;
+
+    DistanceSet(int64_t maxdist)
+    {
+        if (maxdist < (int64_t(1)<<28))
+            bits.resize(maxdist/64+1);
+    }
+    bool contains(int64_t d) const
+    {
+        if (!bits.empty())
+            return (bits[d/64] >> (d%64)) & 1;
+        return hashed.count(d) != 0;
+    }
+    void add(int64_t d)
+    {
+        if (!bits.empty())
+            bits[d/64] |= uint64_t(1) << (d%64);
+        else
+            hashed.insert(d);
+    }
+    void remove(int64_t d)
+    {
+        if (!bits.empty())
+            bits[d/64] &= ~(uint64_t(1) << (d%64));
+        else
+            hashed.erase(d);
+    }
+};
+
+typedef std::vector<uint64_t> WideArrangement;   // sorted point indices.
+
+/*
+ * The runtime sized variant of GridSearch.
+ */
+struct WideSearch {
+    Size size;
+    int ncounters;
+    uint64_t npoints;
+    WideArrangement c;               // point indices of the current prefix.
+    std::vector<int64_t> coords;     // coordinates of the prefix, `dim` per counter.
+    std::vector<int64_t> dists;      // distances of each candidate to the prefix, `ncounters` per depth.
+    DistanceSet used;                // the distances between the counters in the prefix.
+
+    // the sharding of GridSearch.
+    int shard;
+    int nshards;
+    int sharddepth;
+    uint64_t subtrees;
+
+    uint64_t nodes;                  // as in GridSearch.
+    SearchStats *stats;
+    SearchProgress *progress;
+
+    WideSearch(Size size, int ncounters)
+        : size(size), ncounters(ncounters), npoints(pow(size.width, size.dim)),
+          c(ncounters), coords(size_t(ncounters)*size.dim), dists(size_t(ncounters)*ncounters),
+          used(widemaxdist2(size)),
+          shard(0), nshards(1), sharddepth(std::min(1, ncounters-1)), subtrees(0), nodes(0), stats(nullptr), progress(nullptr)
+    {
+    }
+
+    // the coordinates of point index `ix`.
+    static void decode(Size size, uint64_t ix, int64_t *x)
+    {
+        for (int i=size.dim-1 ; i>=0 ; i--) {
+            x[i] = ix % size.width;
+            ix /= size.width;
+        }
+    }
+    void decode(uint64_t ix, int64_t *x) const { decode(size, ix, x); }
+    // step `x` to the coordinates of the next point index.
+    void nextpoint(int64_t *x) const
+    {
+        for (int i=size.dim-1 ; i>=0 ; i--) {
+            if (++x[i] < size.width)
+                return;
+            x[i] = 0;
+        }
+    }
+    int64_t dist2(const int64_t *x, const int64_t *y) const
+    {
+        int64_t total = 0;
+        for (int i=0 ; i<size.dim ; i++)
+            total += (x[i]-y[i])*(x[i]-y[i]);
+        return total;
+    }
+
+    // Calls `found(a)` for each arrangement with unique distances.
+    template<typename FOUND>
+    void run(FOUND found)
+    {
+        if (ncounters==0)
+            found(WideArrangement());
+        else if (uint64_t(ncounters)<=npoints)
+            extend(0, 0, found);
+        if (progress)
+            progress->finished = true;
+    }
+
+    template<typename FOUND>
+    void extend(int depth, uint64_t first, FOUND& found)
+    {
+        uint64_t last = npoints-(ncounters-1-depth);
+        int64_t *x = &coords[size_t(depth)*size.dim];
+        int64_t *d = &dists[size_t(depth)*ncounters];
+
+        if (stats) {
+            stats->depths[depth].candidates += first < last ? last-first : 0;
+            stats->depths[depth].pruned[PRUNE_BOUND] += npoints-std::max(first, last);
+        }
+        decode(first, x);
+        for (uint64_t ix = first ; ix < last ; ix++, nextpoint(x)) {
+            int rule = -1;
+            for (int j=0 ; rule<0 && j<depth ; j++) {
+                d[j] = dist2(&coords[size_t(j)*size.dim], x);
+                if (used.contains(d[j]))
+                    rule = PRUNE_COLLISION;
+                for (int i=0 ; rule<0 && i<j ; i++)
+                    if (d[i] == d[j])
+                        rule = PRUNE_ISOSCELES;
+            }
+            if (rule<0 && depth == sharddepth && (subtrees++ % nshards) != uint64_t(shard))
+                rule = PRUNE_SHARD;
+            if (rule>=0) {
+                if (stats)
+                    stats->depths[depth].pruned[rule]++;
+                continue;
+            }
+            nodes++;
+            if (stats)
+                stats->depths[depth].nodes++;
+            c[depth] = ix;
+            if (depth == ncounters-1) {
+                found(c);
+            }
+            else {
+                if (progress)
+                    progress->publish(depth, ix, nodes);
+                for (int j=0 ; j<depth ; j++)
+                    used.add(d[j]);
+                extend(depth+1, ix+1, found);
+                // the recursion moved the coordinates of deeper counters only.
+                for (int j=0 ; j<depth ; j++)
+                    used.remove(d[j]);
+            }
+        }
+    }
+
+    /*
+     * The image of `a` under generator `g` of the symmetry group: for g < dim-1
+     * swapping axes g and g+1, for g == dim-1 reflecting the first axis.
+     * Together these generate all rotations and reflections.
+     */
+    WideArrangement generator(int g, const WideArrangement& a) const
+    {
+        std::vector<int64_t> x(size.dim);
+        WideArrangement image(a.size());
+        for (size_t i=0 ; i<a.size() ; i++) {
+            decode(a[i], x.data());
+            if (g < size.dim-1)
+                std::swap(x[g], x[g+1]);
+            else
+                x[0] = size.width-1-x[0];
+            uint64_t ix = 0;
+            for (int k=0 ; k<size.dim ; k++)
+                ix = ix*size.width + x[k];
+            image[i] = ix;
+        }
+        std::sort(image.begin(), image.end());
+        return image;
+    }
+
+    /*
+     * Set `best` to the smallest image of `a` under all dim!*2^dim rotations
+     * and reflections, like `GridSymmetry::canonical`, using `rotatepoint`'s
+     * transforms on the decoded coordinates.
+     */
+    void canonical(const WideArrangement& a, WideArrangement& best) const
+    {
+        int n = a.size();
+        std::vector<int64_t> x(size_t(n)*size.dim);
+        for (int i=0 ; i<n ; i++)
+            decode(a[i], &x[size_t(i)*size.dim]);
+        WideArrangement image(n);
+        best = a;
+        Permutation perm(size.dim);
+        for (int flip = 0 ; flip < (1<<size.dim) ; flip++) {
+            do {
+                for (int i=0 ; i<n ; i++) {
+                    const int64_t *p = &x[size_t(i)*size.dim];
+                    uint64_t ix = 0;
+                    for (int k=0 ; k<size.dim ; k++)
+                        ix = ix*size.width + ((flip>>k)&1 ? size.width-1-p[perm[k]] : p[perm[k]]);
+                    image[i] = ix;
+                }
+                std::sort(image.begin(), image.end());
+                if (image < best)
+                    best.swap(image);
+            } while (perm.next());
+        }
+    }
+};
+
+/*
+ * A set of WideArrangements of `n` point indices, stored like SolutionStore:
+ * back to back in one arena, with an open addressing hash table of record numbers.
+ */
+struct WideStore {
+    int n;
+    uint64_t count;
+    std::vector<uint64_t> arena;
+    std::vector<uint32_t> slots;    // record number + 1, or 0 for an empty slot.
+
+    explicit WideStore(int n) : n(n), count(0), slots(64) { }
+
+    uint64_t size() const { return count; }
+    const uint64_t *record(uint64_t i) const { return arena.data() + i*n; }
+
+    static uint64_t hash(const uint64_t *c, int n)
+    {
+        uint64_t h = 0x9E3779B97F4A7C15;
+        for (int i=0 ; i<n ; i++)
+            h = (h ^ c[i]) * 0xFF51AFD7ED558CCD;
+        return h ^ (h >> 29);
+    }
+
+    // the slot holding `c`, or the empty slot where it would go.
+    uint64_t findslot(const uint64_t *c) const
+    {
+        uint64_t mask = slots.size()-1;
+        for (uint64_t i = hash(c, n) & mask ; ; i = (i+1) & mask) {
+            if (slots[i]==0 || std::equal(c, c+n, record(slots[i]-1)))
+                return i;
+        }
+    }
+
+    bool contains(const WideArrangement& a) const
+    {
+        return slots[findslot(a.data())] != 0;
+    }
+
+    // returns false when `a` was already there.
+    bool insert(const WideArrangement& a)
+    {
+        uint64_t i = findslot(a.data());
+        if (slots[i])
+            return false;
+        arena.insert(arena.end(), a.begin(), a.end());
+        slots[i] = ++count;
+        if (count*2 > slots.size()) {
+            slots.assign(slots.size()*2, 0);
+            for (uint64_t r = 0 ; r < count ; r++)
+                slots[findslot(record(r))] = r+1;
+        }
+        return true;
+    }
+};
+
+/*
+ * Find all solutions for a grid beyond the fixed size limits.
+ */
+SolveResult searchwide(Size size, int ncounters, const SolverOptions& opts)
+{
+    // up to MAXDIM dimensions each class is stored once, by its canonical
+    // arrangement. Beyond that the dim!*2^dim transforms are too many to try
+    // for each solution. But every image of a solution is itself a solution,
+    // so storing the whole orbit of each new class costs `countu` entries, and
+    // makes each later duplicate a single lookup. The orbit is found by a
+    // walk over the generators of the symmetry group.
+    bool orbits = size.dim > MAXDIM;
+    WideStore seen(ncounters);
+    WideArrangement key;
+    uint64_t countu = 0;
+    uint64_t classes = 0;
+
+    WideSearch search(size, ncounters);
+    search.shard = opts.shard;
+    search.nshards = opts.nshards;
+    SolveResult result;
+    if (opts.stats)
+        result.stats.depths.resize(ncounters);
+    search.stats = opts.stats ? &result.stats : nullptr;
+    search.progress = opts.progress;
+    // the wide kernels are slow enough to time every call, distances are part of the enumeration.
+    PhaseTimers& timers = result.phases;
+    std::string out;
+    auto wall0 = std::chrono::steady_clock::now();
+    uint64_t tsc0 = readtsc();
+    search.run([&](const WideArrangement& a) {
+        countu++;
+        if (opts.progress)
+            SearchProgress::set(opts.progress->countu, countu);
+        uint64_t t = readtsc();
+        if (!orbits)
+            search.canonical(a, key);
+        if (orbits ? seen.contains(a) : !seen.insert(key)) {
+            timers.add(PHASE_DEDUP, t);
+            if (opts.stats)
+                result.stats.depths[ncounters-1].pruned[PRUNE_SYMMETRY]++;
+            return;
+        }
+        if (opts.stats && ncounters)
+            result.stats.depths[ncounters-1].solutions++;
+        classes++;
+        if (opts.progress)
+            SearchProgress::set(opts.progress->solutions, classes);
+        std::vector<WideArrangement> queue;
+        if (orbits) {
+            queue.push_back(a);
+            seen.insert(a);
+        }
+        while (!queue.empty()) {
+            WideArrangement b = std::move(queue.back());
+            queue.pop_back();
+            for (int g=0 ; g<std::max(size.dim, 1) ; g++) {
+                auto image = search.generator(g, b);
+                if (seen.insert(image))
+                    queue.push_back(std::move(image));
+            }
+        }
+        timers.add(PHASE_DEDUP, t);
+        if (opts.printall) {
+            t = readtsc();
+            out = "-----\n";
+            renderarrangement(out, size, a);
+            std::cout.write(out.data(), out.size());
+            timers.add(PHASE_OUTPUT, t);
+        }
+    });
+    timers.total = readtsc()-tsc0;
+    timers.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now()-wall0).count();
+
+    result.solutions = classes;
+    result.countu = countu;
+    result.nodes = search.nodes;
+    return result;
+}
+
+
+/*
+ * Estimate the size and running time of a search with Knuth's estimator.
+ *
+ * Each probe is a random walk from the root, where a node with `d` children
+ * stands for `d` times as many nodes one level deeper: so the product of the
+ * numbers of children on the way estimates the number of nodes at each depth,
+ * and of leaves, the arrangements with unique distances. The time is estimated
+ * in the same way, from the time each node on the way took. All these are
+ * unbiased, their spread over the probes gives the confidence intervals.
+ */
+struct SearchEstimate {
+    int nprobes;
+    std::vector<double> nodes;     // the mean estimated number of nodes at each depth.
+    double total[3];               // the mean estimates of all nodes, leaves and seconds.
+    double error[3];               // their 95% confidence interval, as a fraction.
+    double seconds;                // the time the probes took.
+};
+
+/*
+ * Runs the probes on `shape`, and times the deduplication of the leaves
+ * with `symmetry` unless that is NULL. The same seed makes every shape of
+ * the same grid take the same random walks.
+ */
+template<typename SHAPE>
+SearchEstimate estimateshape(const SHAPE& shape, const SolverOptions& opts, const GridSymmetry *symmetry, int nprobes)
+{
+    int ncounters = shape.ncounters();
+    GridSearch<SHAPE> search(shape, opts.kernel);
+    std::mt19937_64 rng(1);
+
+    SearchEstimate e;
+    e.nprobes = nprobes;
+    e.nodes.assign(ncounters+1, 0);
+    double sum[3] = { }, sumsq[3] = { };
+    std::vector<uint64_t> children(ncounters), cycles(ncounters);
+    uint64_t dedupcycles = 0, ndedup = 0;
+
+    auto wall0 = std::chrono::steady_clock::now();
+    uint64_t tsc0 = readtsc();
+    for (int p=0 ; p<nprobes ; p++) {
+        int depth = ncounters<=shape.npoints() ? search.probe(rng, children.data(), cycles.data()) : -1;
+
+        double weight = 1;   // the nodes the current one stands for.
+        double x[3] = { 0, 0, 0 };
+        e.nodes[0] += 1.0/nprobes;
+        for (int d=0 ; d<=depth && d<ncounters ; d++) {
+            x[2] += weight*cycles[d];
+            weight *= children[d];
+            x[0] += weight;
+            e.nodes[d+1] += weight/nprobes;
+        }
+        if (depth == ncounters)
+            x[1] = weight;
+        if (depth == ncounters && symmetry) {
+            // the leaves are also deduplicated, time that for this one.
+            uint64_t t = readtsc();
+            IndexArrangement a;
+            for (int i=0 ; i<ncounters ; i++)
+                a.add(search.c[i]);
+            symmetry->canonical(opts.kernel, a);
+            dedupcycles += readtsc()-t;
+            ndedup++;
+        }
+        for (int k=0 ; k<3 ; k++) {
+            sum[k] += x[k];
+            sumsq[k] += x[k]*x[k];
+        }
+    }
+    e.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now()-wall0).count();
+    uint64_t tsc = readtsc()-tsc0;
+    double secondspercycle = tsc ? e.seconds/tsc : 0;
+
+    for (int k=0 ; k<3 ; k++) {
+        double mean = sum[k]/nprobes;
+        double var = std::max(sumsq[k]/nprobes - mean*mean, 0.0);
+        e.total[k] = mean;
+        e.error[k] = mean>0 && nprobes>1 ? 1.96*sqrt(var/(nprobes-1))/mean : 0;
+    }
+    e.total[2] *= secondspercycle;
+    if (ndedup)
+        e.total[2] += e.total[1] * double(dedupcycles)/ndedup * secondspercycle;
+    return e;
+}
+
+SearchEstimate estimatesearch(const SolverOptions& opts, Size size, int ncounters, int nprobes)
+{
+    GridSymmetry symmetry(size, opts.cachedir);
+    return estimateshape(Shape(size, ncounters), opts, &symmetry, nprobes);
+}
+
+/*
+ * The grid configurations from the README tables which get their own
+ * compile time specialized solver, as (dim, width, ncounters).
+ */
+#define SPECIALIZED_GRIDS(X) \
+    X(2, 2, 2) X(2, 3, 3) X(2, 4, 4) X(2, 5, 5) X(2, 6, 6) X(2, 7, 7) \
+    X(2, 8, 7) X(2, 8, 8) X(2, 9, 8) X(2, 10, 8) X(2, 11, 9) X(2, 12, 9) \
+    X(2, 13, 9) X(2, 14, 8) X(2, 15, 8) \
+    X(3, 2, 2) X(3, 2, 3) X(3, 3, 3) X(3, 3, 4) X(3, 4, 4) X(3, 4, 6) \
+    X(3, 5, 5) X(3, 5, 7) X(3, 6, 6) X(3, 6, 8) X(3, 7, 7) X(3, 7, 8) \
+    X(4, 2, 2) X(4, 2, 3) X(4, 3, 3) X(4, 3, 5) X(4, 4, 4) X(4, 4, 7) \
+    X(5, 2, 2) X(5, 2, 3) X(5, 3, 3) X(5, 3, 6) X(5, 4, 4) \
+    X(6, 2, 2) X(6, 2, 4) X(6, 3, 3) X(6, 3, 6) X(6, 4, 3) \
+    X(7, 2, 2) X(7, 2, 4) X(7, 3, 3) X(7, 3, 4) X(7, 4, 3)
+
+struct SpecializedSolver {
+    int dim;
+    int width;
+    int ncounters;
+    SolveResult (*solve)(const SolverOptions& opts);
+    SearchEstimate (*probe)(const SolverOptions& opts, int nprobes);   // probes without deduplication, for benchmarks.
+};
+
+#define SPECIALIZED_SOLVER(D, W, N) \
+    { D, W, N, [](const SolverOptions& opts) { return searchgrid(FixedShape<D, W, N>(), opts); }, \
+      [](const SolverOptions& opts, int nprobes) { return estimateshape(FixedShape<D, W, N>(), opts, NULL, nprobes); } },
+
+const SpecializedSolver specializedsolvers[] = {
+    SPECIALIZED_GRIDS(SPECIALIZED_SOLVER)
+};
+
+// returns the specialized solver for this grid, or NULL.
+const SpecializedSolver *findspecialized(Size size, int ncounters)
+{
+    for (auto& s : specializedsolvers)
+        if (s.dim==size.dim && s.width==size.width && s.ncounters==ncounters)
+            return &s;
+    return NULL;
+}
+
+/*
+ * Find all solutions for a `size` grid with `ncounters` counters,
+ * using a specialized solver when there is one, and the wide solver
+ * when the grid does not fit the fixed size types.
+ */
+SolveResult solve(Size size, int ncounters, const SolverOptions& opts)
+{
+    if (needswide(size, ncounters))
+        return searchwide(size, ncounters, opts);
+    if (!opts.generic) {
+        if (auto s = findspecialized(size, ncounters))
+            return s->solve(opts);
+    }
+    return searchgrid(Shape(size, ncounters), opts);
+}
+
+/*
+ * Generate and print all solutions for a `size` grid with `ncounters` counters.
+ */
+void solvegrid(const SolverOptions& options, Size size, int ncounters)
+{
+    SolverOptions opts = options;
+    std::ostream& report = opts.report();
+    Rank total = fitswide(size) ? generatecombinations::totalcombinations(ncounters, pow(size.width, size.dim)) : 0;
+
+    if (opts.verbose)
+        report << "Using the " << (needswide(size, ncounters) ? "wide" : !opts.generic && findspecialized(size, ncounters) ? "specialized" : "generic") << " solver for " << size << " with " << ncounters << " counters, " << kernelname(opts.kernel) << " kernel.\n";
+
+    std::unique_ptr<SolutionWriter> writer;
+    if (opts.format != FORMAT_TEXT) {
+        std::cout.flush();
+        writer.reset(new SolutionWriter(1, opts.format, size));
+        opts.writer = writer.get();
+    }
+
+    time_t t0 = time(NULL);
+
+    SearchProgress progress;
+    progress.start(pow(size.width, size.dim), ncounters);
+    std::unique_ptr<ProgressReporter> reporter, jsonreporter;
+    if (opts.verbose) {
+        opts.progress = &progress;
+        reporter.reset(new ProgressReporter(progress, report, opts.progressinterval));
+    }
+    if (opts.progressfd != -1) {
+        std::ostringstream fields;
+        fields << "\"pid\":" << getpid() << ",\"width\":" << size.width << ",\"dim\":" << size.dim << ",\"n\":" << ncounters
+               << ",\"shard\":" << opts.shard << ",\"nshards\":" << opts.nshards << ",";
+        opts.progress = &progress;
+        jsonreporter.reset(new ProgressReporter(progress, opts.progressfd, fields.str(), opts.progressinterval));
+    }
+
+    SolveResult result = solve(size, ncounters, opts);
+    reporter.reset();
+    jsonreporter.reset();
+
+    bool writefailed = writer && !writer->close();
+    time_t t = time(NULL);
+    report << "\n";
+    report << "Found " << result.solutions << " solutions in " << tostring(total) << " total arangements, in " << (t-t0) << " seconds.\n";
+    report << result.countu << " unique\n";
+    if (result.catalogfailed && opts.memorylimit)
+        report << "could not spill to " << opts.spilldir << (opts.catalog ? " or write catalog " : "") << (opts.catalog ? opts.catalog : "") << "\n";
+    else if (result.catalogfailed)
+        report << "could not write catalog " << opts.catalog << "\n";
+    if (writefailed)
+        report << "could not write all solutions\n";
+    if (opts.verbose || opts.stats == STATS_TEXT)
+        result.phases.print(report);
+    if (opts.stats == STATS_TEXT)
+        result.stats.print(report);
+    else if (opts.stats == STATS_JSON)
+        result.stats.printjson(report, result.phases);
+}
+
+void printestimate(const SolverOptions& opts, Size size, int ncounters, const SearchEstimate& e)
+{
+    if (needswide(size, ncounters)) {
+        std::cout << "estimates are limited to " << MAXPOINTS << " points and " << MAXCOUNTERS << " counters\n";
+        return;
+    }
+    double transforms = 1;
+    for (int i=1 ; i<=size.dim ; i++)
+        transforms *= 2*i;
+    auto interval = [](double error) {
+        std::ostringstream os;
+        os << " +/- " << std::fixed << std::setprecision(1) << 100*error << "%";
+        return os.str();
+    };
+
+    std::cout << "Estimate for " << size << " with " << ncounters << " counters, from " << e.nprobes << " probes in "
+              << std::fixed << std::setprecision(2) << e.seconds << " seconds, with 95% confidence intervals:\n";
+    std::cout << std::scientific << std::setprecision(3);
+    std::cout << "nodes       " << e.total[0] << interval(e.error[0]) << "\n";
+    for (size_t d=1 ; d<e.nodes.size() ; d++)
+        std::cout << "  depth " << std::setw(2) << d << "  " << std::scientific << std::setprecision(3) << e.nodes[d] << "\n";
+    std::cout << std::scientific << std::setprecision(3);
+    std::cout << "unique      " << e.total[1] << interval(e.error[1]) << "\n";
+    std::cout << "solutions   " << e.total[1]/transforms << ", about, as most have " << transforms << " rotations and reflections\n";
+    double seconds = e.total[2]/opts.nshards;
+    std::cout << "time        ";
+    if (seconds < 60)
+        std::cout << std::fixed << std::setprecision(3) << seconds << "s";
+    else
+        std::cout << formatduration(seconds);
+    std::cout << interval(e.error[2]);
+    if (opts.nshards > 1)
+        std::cout << " for each of " << opts.nshards << " shards";
+    std::cout << std::defaultfloat << "\n";
+}
+
+/*
+ * Print the header, and with -p all solutions, of a catalog file.
+ */
+int showcatalog(const SolverOptions& opts, const char *path)
+{
+    CatalogReader reader;
+    if (!reader.open(path)) {
+        std::cout << "not a catalog: " << path << "\n";
+        return 1;
+    }
+    const CatalogHeader *header = reader.header;
+    Size size = reader.size();
+    std::cout << (reader.compressed() ? "Compressed catalog" : "Catalog") << " for " << size << " with " << header->n << " counters, engine version " << header->engine << ".\n";
+    if (opts.printall) {
+        SolverOptions o = opts;
+        std::unique_ptr<SolutionWriter> writer;
+        if (opts.format != FORMAT_TEXT) {
+            std::cout.flush();
+            writer.reset(new SolutionWriter(1, opts.format, size));
+            o.writer = writer.get();
+        }
+        IndexArrangement a;
+        std::string out;
+        while (reader.next(a))
+            printsolution(o, size, a, a, out);
+    }
+    std::cout << header->count << " solutions, " << header->countu << " unique\n";
+    return 0;
+}
+
+/*
+ * Verification of arrangements from other runs, or other programs.
+ *
+ * Each arrangement is checked for the right number of distinct points
+ * inside the grid with unique distances, and optionally for being
+ * the first of its class. Records are checked in parallel, in batches.
+ */
+enum { VERIFY_OK, VERIFY_PARSE, VERIFY_COUNT, VERIFY_RANGE, VERIFY_SAMEPOINT, VERIFY_DISTANCE, VERIFY_NOTCANONICAL, VERIFY_DUPLICATE };
+
+const char *verifyreason(int result)
+{
+    static const char *reasons[] = { "ok", "can not parse", "wrong number of counters", "point outside the grid",
+                                     "duplicate point", "distances not unique", "not canonical", "duplicate solution" };
+    return reasons[result];
+}
+
+/*
+ * Run `f(i)` for all `i` below `n` on `nthreads` threads.
+ */
+template<typename F>
+void parallelfor(uint64_t n, int nthreads, F f)
+{
+    std::atomic<uint64_t> next(0);
+    auto work = [&]() {
+        const uint64_t step = 256;
+        for (uint64_t b = next.fetch_add(step) ; b < n ; b = next.fetch_add(step))
+            for (uint64_t i = b ; i < std::min(b+step, n) ; i++)
+                f(i);
+    };
+    std::vector<std::thread> threads;
+    for (int t = 1 ; t < nthreads ; t++)
+        threads.emplace_back(work);
+    work();
+    for (auto& t : threads)
+        t.join();
+}
+
+struct Verifier {
+    Size size;
+    int ncounters;
+    int kernel;
+    bool dedup;         // compute canonical keys, for finding duplicates.
+    bool canonical;     // also require each arrangement to be the canonical one of its class.
+    GridSymmetry symmetry;
+
+    Verifier(Size size, int ncounters, int kernel, bool dedup, bool canonical, const char *cachedir = nullptr)
+        : size(size), ncounters(ncounters), kernel(kernel), dedup(dedup || canonical), canonical(canonical), symmetry(size, cachedir)
+    {
+    }
+
+    /*
+     * Is `line` a record of --format=csv: a rank, the point indices, the
+     * coordinates with ';' between the points, and the key indices. Plain
+     * coordinates separated by commas and spaces may also have four fields,
+     * but not with this structure.
+     */
+    bool iscsv(const std::string& line) const
+    {
+        std::vector<std::string> fields;
+        std::istringstream is(line);
+        for (std::string f ; std::getline(is, f, ',') ; )
+            fields.push_back(f);
+        if (fields.size() != 4 || fields[0].empty() || fields[0].find_first_not_of("0123456789") != std::string::npos)
+            return false;
+        auto numbers = [](const std::string& f) {
+            std::istringstream is(f);
+            int n = 0;
+            for (std::string x ; is >> x ; n++)
+                if (x.find_first_not_of("0123456789") != std::string::npos)
+                    return -1;
+            return n;
+        };
+        if (numbers(fields[1]) != ncounters || numbers(fields[3]) != ncounters)
+            return false;
+        std::istringstream coords(fields[2]);
+        int npoints = 0;
+        for (std::string point ; std::getline(coords, point, ';') ; npoints++)
+            if (numbers(point) != size.dim)
+                return false;
+        return npoints == ncounters;
+    }
+
+    /*
+     * Parse the coordinates of an arrangement from a line: from the "coords" of
+     * --format=jsonl, the third column of --format=csv, or otherwise all
+     * numbers in the line.
+     */
+    int parse(const std::string& line, IndexArrangement& a) const
+    {
+        const char *p = line.c_str();
+        const char *end = p + line.size();
+        if (const char *q = strstr(p, "\"coords\"")) {
+            p = q;
+            if (const char *e = strstr(p, "]]"))
+                end = e;
+        }
+        else if (iscsv(line)) {
+            for (int i=0 ; i<2 ; i++)
+                p = strchr(p, ',')+1;
+            end = strchr(p, ',');
+        }
+
+        std::vector<int64_t> coords;
+        while (p < end) {
+            if (!isdigit(*p) && !(*p=='-' && p+1<end && isdigit(p[1]))) {
+                p++;
+                continue;
+            }
+            char *e;
+            coords.push_back(strtoll(p, &e, 10));
+            p = e;
+        }
+        if (coords.empty())
+            return VERIFY_PARSE;
+        if (size.dim == 0 || coords.size() != size_t(ncounters)*size.dim)
+            return VERIFY_COUNT;
+
+        a = IndexArrangement();
+        for (int i=0 ; i<ncounters ; i++) {
+            int ix = 0;
+            for (int k=0 ; k<size.dim ; k++) {
+                int64_t x = coords[i*size.dim+k];
+                if (x < 0 || x >= size.width)
+                    return VERIFY_RANGE;
+                ix = ix*size.width + x;
+            }
+            a.add(ix);
+        }
+        return VERIFY_OK;
+    }
+
+    int check(const IndexArrangement& a, IndexArrangement& key) const
+    {
+        if (a.n != ncounters)
+            return VERIFY_COUNT;
+        for (int i=0 ; i<a.n ; i++)
+            if (a[i] >= pow(size.width, size.dim))
+                return VERIFY_RANGE;
+        for (int i=1 ; i<a.n ; i++)
+            if (a[i-1] == a[i])
+                return VERIFY_SAMEPOINT;
+
+        int d[MAXCOUNTERS*(MAXCOUNTERS-1)/2];
+        int nd = 0;
+        for (int i=0 ; i<a.n ; i++)
+            for (int j=0 ; j<i ; j++)
+                d[nd++] = symmetry.packed.empty() ? dist2(makepoint(size, a[i]), makepoint(size, a[j]))
+                                                  : dist2(symmetry.packed[a[i]], symmetry.packed[a[j]]);
+        std::sort(d, d+nd);
+        if (std::adjacent_find(d, d+nd) != d+nd)
+            return VERIFY_DISTANCE;
+
+        if (!dedup)
+            return VERIFY_OK;
+        key = symmetry.canonical(kernel, a);
+        if (canonical && key != a)
+            return VERIFY_NOTCANONICAL;
+        return VERIFY_OK;
+    }
+};
+
+/*
+ * Verify arrangements read from stdin, or from the catalog `path`.
+ *
+ * Invalid records are reported on stdout, with -p only the valid input
+ * lines are output instead. With --dedup classes found before are
+ * reported as duplicates. Returns 1 when any record was invalid.
+ */
+int verifyarrangements(const SolverOptions& opts, const char *path, Size size, int ncounters)
+{
+    CatalogReader reader;
+    if (path) {
+        if (!reader.open(path)) {
+            std::cout << "not a catalog: " << path << "\n";
+            return 1;
+        }
+        size = reader.size();
+        ncounters = reader.header->n;
+    }
+    if (needswide(size, ncounters)) {
+        std::cout << "verification is limited to " << MAXPOINTS << " points and " << MAXCOUNTERS << " counters\n";
+        return 1;
+    }
+
+    Verifier verifier(size, ncounters, opts.kernel, opts.dedup, path && opts.dedup, opts.cachedir);
+    SolutionStore seen(ncounters);
+    uint64_t nrecords = 0, ninvalid = 0, nduplicates = 0;
+    time_t t0 = time(NULL);
+
+    const uint64_t BATCH = 65536;
+    std::vector<std::string> lines;
+    std::vector<IndexArrangement> arrangements(BATCH), keys(BATCH);
+    std::vector<int> results(BATCH);
+    std::string out;
+    bool more = true;
+    while (more) {
+        // read a batch.
+        uint64_t n = 0;
+        if (path) {
+            while (n < BATCH && (more = reader.next(arrangements[n])))
+                n++;
+        }
+        else {
+            lines.resize(BATCH);
+            while (n < BATCH && (more = bool(std::getline(std::cin, lines[n])))) {
+                const std::string& line = lines[n];
+                if (line.empty() || line[0]=='#' || line.compare(0, 5, "rank,")==0 || line.compare(0, 5, "-----")==0)
+                    continue;
+                n++;
+            }
+        }
+
+        parallelfor(n, opts.nthreads, [&](uint64_t i) {
+            results[i] = path ? VERIFY_OK : verifier.parse(lines[i], arrangements[i]);
+            if (results[i] == VERIFY_OK)
+                results[i] = verifier.check(arrangements[i], keys[i]);
+        });
+
+        // duplicates, and output, in input order.
+        out.clear();
+        for (uint64_t i=0 ; i<n ; i++) {
+            if (results[i] == VERIFY_OK && opts.dedup && !seen.insert(keys[i])) {
+                results[i] = VERIFY_DUPLICATE;
+                nduplicates++;
+            }
+            if (results[i] != VERIFY_OK)
+                ninvalid++;
+
+            if (opts.printall) {
+                if (results[i] == VERIFY_OK && !path)
+                    out += lines[i] + "\n";
+                else if (results[i] == VERIFY_OK)
+                    renderarrangement(out += "-----\n", size, arrangements[i]);
+            }
+            else if (results[i] != VERIFY_OK) {
+                out += "record " + std::to_string(nrecords+i+1) + ": " + verifyreason(results[i]);
+                if (!path)
+                    out += ": " + lines[i];
+                out += "\n";
+            }
+        }
+        std::cout.write(out.data(), out.size());
+        nrecords += n;
+    }
+    std::cout.flush();
+
+    std::cerr << "Checked " << nrecords << " arrangements for " << size << " with " << ncounters << " counters: "
+              << nrecords-ninvalid << " valid, " << ninvalid << " invalid";
+    if (opts.dedup)
+        std::cerr << " of which " << nduplicates << " duplicates";
+    std::cerr << ", in " << (time(NULL)-t0) << " seconds.\n";
+    return ninvalid ? 1 : 0;
+}
+
+#ifndef NOMAIN
+int main(int argc, char**argv)
+{
+    Size size;
+    int ncounters = -1;
+    size.width = 3;
+    size.dim = 2;
+
+    SolverOptions opts;
+    bool verify = false;
+    int estimate = 0;     // the number of probes for --estimate.
+
+    while (argc>=2 && argv[1][0]=='-') {
+        if (argv[1][1] == 'p') {
+            opts.printall = true;
+            argv++; argc--;
+        }
+        else if (argv[1][1] == 'r') {
+            opts.printall = opts.printranks = true;
+            argv++; argc--;
+        }
+        else if (strncmp(argv[1], "--format=", 9)==0) {
+            const char *name = argv[1]+9;
+            opts.format = strcmp(name, "jsonl")==0 ? FORMAT_JSONL : strcmp(name, "csv")==0 ? FORMAT_CSV : strcmp(name, "text")==0 ? FORMAT_TEXT : -1;
+            if (opts.format == -1) {
+                std::cout << "unknown format: " << name << "\n";
+                return 1;
+            }
+            opts.printall |= opts.format != FORMAT_TEXT;
+            argv++; argc--;
+        }
+        else if (argv[1][1] == 'v') {
+            opts.verbose = strlen(argv[1])-1;
+            argv++; argc--;
+        }
+        else if (argv[1][1] == 'g') {
+            opts.generic = true;
+            argv++; argc--;
+        }
+        else if (strncmp(argv[1], "--kernel=", 9)==0) {
+            const char *name = argv[1]+9;
+            if (strcmp(name, "list")==0) {
+                for (int k=0 ; k<NKERNELS ; k++)
+                    std::cout << kernelname(k) << (kernelsupported(k) ? "" : " (unsupported)") << (k==bestkernel() ? " (default)" : "") << "\n";
+                return 0;
+            }
+            opts.kernel = findkernel(name);
+            if (opts.kernel == -1) {
+                std::cout << "unknown kernel: " << name << "\n";
+                return 1;
+            }
+            if (!kernelsupported(opts.kernel)) {
+                std::cout << "kernel not supported by this cpu: " << name << "\n";
+                return 1;
+            }
+            argv++; argc--;
+        }
+        else if (argv[1][1] == 'z') {
+            opts.compress = true;
+            argv++; argc--;
+        }
+        else if (argv[1][1] == 'o' && argc>=3) {
+            opts.catalog = argv[2];
+            argv+=2; argc-=2;
+        }
+        else if (argv[1][1] == 's' && argc>=3) {
+            if (sscanf(argv[2], "%d/%d", &opts.shard, &opts.nshards) != 2 || opts.nshards < 1 || opts.shard < 0 || opts.shard >= opts.nshards) {
+                std::cout << "expected -s SHARD/NSHARDS, with 0 <= SHARD < NSHARDS\n";
+                return 1;
+            }
+            argv+=2; argc-=2;
+        }
+        else if (argv[1][1] == 'm' && argc>=3) {
+            char *end;
+            uint64_t mb = strtoull(argv[2], &end, 10);
+            if (end == argv[2] || *end || argv[2][0] == '-' || mb == 0 || mb > (UINT64_MAX >> 20)) {
+                std::cout << "expected -m MB, a whole positive number of megabytes\n";
+                return 1;
+            }
+            opts.memorylimit = mb << 20;
+            argv+=2; argc-=2;
+        }
+        else if (strncmp(argv[1], "--spill=", 8)==0) {
+            opts.spilldir = argv[1]+8;
+            argv++; argc--;
+        }
+        else if (strcmp(argv[1], "--estimate")==0 || strncmp(argv[1], "--estimate=", 11)==0) {
+            estimate = argv[1][10] ? std::max(1, int(strtol(argv[1]+11, 0, 0))) : 10000;
+            argv++; argc--;
+        }
+        else if (strncmp(argv[1], "--progress=json", 15)==0 && (argv[1][15]==0 || argv[1][15]==':')) {
+            opts.progressfd = argv[1][15] ? int(strtol(argv[1]+16, 0, 0)) : 2;
+            if (fcntl(opts.progressfd, F_GETFD) == -1) {
+                std::cout << "progress file descriptor " << opts.progressfd << " is not open\n";
+                return 1;
+            }
+            argv++; argc--;
+        }
+        else if (strncmp(argv[1], "--interval=", 11)==0) {
+            opts.progressinterval = std::max(0.01, strtod(argv[1]+11, 0));
+            argv++; argc--;
+        }
+        else if (strcmp(argv[1], "--stats")==0 || strcmp(argv[1], "--stats=json")==0) {
+            opts.stats = argv[1][7] ? STATS_JSON : STATS_TEXT;
+            argv++; argc--;
+        }
+        else if (strncmp(argv[1], "--cache=", 8)==0) {
+            opts.cachedir = argv[1]+8;
+            argv++; argc--;
+        }
+        else if (argv[1][1] == 'j' && argc>=3) {
+            opts.nthreads = std::max(1, int(strtol(argv[2], 0, 0)));
+            argv+=2; argc-=2;
+        }
+        else if (strcmp(argv[1], "--dedup")==0) {
+            opts.dedup = true;
+            argv++; argc--;
+        }
+        else if (strncmp(argv[1], "--verify=", 9)==0) {
+            return verifyarrangements(opts, argv[1]+9, size, ncounters);
+        }
+        else if (strcmp(argv[1], "--verify")==0) {
+            verify = true;
+            argv++; argc--;
+        }
+        else if (strncmp(argv[1], "--catalog=", 10)==0) {
+            return showcatalog(opts, argv[1]+10);
+        }
+        else if (strcmp(argv[1], "--merge")==0 && opts.catalog) {
+            return mergecatalogs(opts.catalog, opts.compress, std::vector<const char*>(argv+2, argv+argc));
+        }
+        else {
+            std::cout << "Usage: " << argv[0] << " [-p|-r|--format=FMT] [-v] [-g] [--kernel=NAME] [-o CATALOG [-z]] [-s SHARD/NSHARDS] [-m MB [--spill=DIR]] [--cache=DIR] [--stats[=json]] [--progress=json[:FD] [--interval=SECONDS]] [--estimate[=PROBES]] [width [dimension [ncounters]]]\n";
+            std::cout << "       " << argv[0] << " [-p] --catalog=CATALOG\n";
+            std::cout << "       " << argv[0] << " -o CATALOG [-z] --merge CATALOG...\n";
+            std::cout << "       " << argv[0] << " [-p] [-j N] [--dedup] --verify [width [dimension [ncounters]]]  < arrangements\n";
+            std::cout << "       " << argv[0] << " [-p] [-j N] [--dedup] --verify=CATALOG\n";
+            std::cout << "    -p   print all solutions\n";
+            std::cout << "    -r   print all solutions as the combination rank of their canonical arrangement\n";
+            std::cout << "    --format=FMT  print all solutions as jsonl or csv, with the summary on stderr\n";
+            std::cout << "    -v   show progress\n";
+            std::cout << "    -g   always use the generic solver\n";
+            std::cout << "    --kernel=NAME  use the generic, avx2 or avx512 kernels, 'list' shows which this cpu supports\n";
+            std::cout << "    -o CATALOG  write the solutions to a binary catalog file\n";
+            std::cout << "    -z   compress the catalog, storing delta encoded combination ranks\n";
+            std::cout << "    --catalog=CATALOG  show the solutions in a catalog file\n";
+            std::cout << "    -s SHARD/NSHARDS  search only one of NSHARDS parts of the search\n";
+            std::cout << "    --merge CATALOG...  merge catalogs into the -o CATALOG, dropping duplicate solutions\n";
+            std::cout << "    -m MB  keep at most MB megabytes of solutions in memory, spilling sorted runs to disk\n";
+            std::cout << "    --spill=DIR  spill to DIR instead of /tmp\n";
+            std::cout << "    --stats  print how many nodes each depth of the search visited, and pruned by which rule, --stats=json as JSON\n";
+            std::cout << "    --progress=json[:FD]  write progress as JSON lines to stderr, or file descriptor FD\n";
+            std::cout << "    --interval=SECONDS  seconds between progress reports, 1 by default\n";
+            std::cout << "    --estimate[=PROBES]  estimate the size and time of the search from random probes, 10000 by default\n";
+            std::cout << "    --cache=DIR  keep the symmetry tables of each grid in DIR, for faster starts\n";
+            std::cout << "    --verify  check arrangements, one per line, as text, jsonl or csv, report invalid ones, with -p output only the valid ones\n";
+            std::cout << "    --dedup  with --verify also report duplicate solutions, and for catalogs non canonical ones\n";
+            std::cout << "    -j N  use N threads for --verify\n";
+            return 0;
+        }
+    }
+
+    if (argc>=2)
+        size.width = strtol(argv[1], 0, 0);
+
+    if (argc>=3)
+        size.dim = strtol(argv[2], 0, 0);
+    if (argc>=4)
+        ncounters = strtol(argv[3], 0, 0);
+    if (ncounters==-1)
+        ncounters = size.width;
+
+    if (size.dim < 0 || size.width < 0 || ncounters < 0) {
+        std::cout << "width, dimension and ncounters must not be negative\n";
+        return 1;
+    }
+    if (!fitswide(size)) {
+        std::cout << "the number of grid points must fit in 64 bits\n";
+        return 1;
+    }
+    if (opts.catalog && needswide(size, ncounters)) {
+        std::cout << "catalogs are limited to " << MAXPOINTS << " points and " << MAXCOUNTERS << " counters\n";
+        return 1;
+    }
+    if (opts.memorylimit && needswide(size, ncounters)) {
+        std::cout << "-m is limited to " << MAXPOINTS << " points and " << MAXCOUNTERS << " counters\n";
+        return 1;
+    }
+    if (((opts.catalog && opts.compress) || opts.printranks || opts.format != FORMAT_TEXT) && (needswide(size, ncounters) || !ranksfit(pow(size.width, size.dim), ncounters))) {
+        std::cout << "ranks are limited to " << MAXPOINTS << " points, " << MAXCOUNTERS << " counters, and 128 bits\n";
+        return 1;
+    }
+
+    if (verify)
+        return verifyarrangements(opts, nullptr, size, ncounters);
+    if (estimate) {
+        if (needswide(size, ncounters))
+            printestimate(opts, size, ncounters, SearchEstimate());
+        else
+            printestimate(opts, size, ncounters, estimatesearch(opts, size, ncounters, estimate));
+        return 0;
     }
 
-    solvegrid(printall, verbose, size, ncounters);
+    solvegrid(opts, size, ncounters);
 }
 #endif
@@ -1,4 +1,5 @@
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#define DOCTEST_CONFIG_NO_POSIX_SIGNALS
 #include "contrib/doctest.h"
 #define SECTION(...) SUBCASE(__VA_ARGS__)
 #define SKIPTEST  * doctest::skip(true)
@@ -6,6 +7,13 @@
 
 #define NOMAIN 1
 #include "mpmp7-unique-distances.cpp"
+#include <sstream>
+
+namespace doctest {
+    template<> struct StringMaker<Rank> {
+        static String convert(Rank r) { return tostring(r).c_str(); }
+    };
+}
 
 TEST_CASE("math") {
     CHECK(pow(2,8) == 256);
@@ -71,11 +79,248 @@ TEST_CASE("arrangement") {
 }
 TEST_CASE("generate") {
     int i = 0;
-    for (auto a : generatearrangements(Size(4, 3), 2))
+    for (auto a : generatecombinations(2, pow(3, 4)))
         i++;
-    CHECK( i == generatearrangements::totalarrangements(Size(4, 3), 2) );
+    CHECK( i == generatecombinations::totalcombinations(2, pow(3, 4)) );
+}
+
+TEST_CASE("extensionmask")
+{
+    Size size(2, 5);
+    auto pts = allpoints(size);
+    PointColumns cols(size, pts);
+    std::unique_ptr<FixedSet> used(new FixedSet(maxdist2(size)));
+
+    Point prefix[2] = { make<Point>(0,0), make<Point>(0,1) };
+    used->add(dist2(prefix[0], prefix[1]));
+
+    for (int first = 0 ; first < 25 ; first += LANES) {
+        uint32_t mask = extensionmask(size.dim, cols, prefix, 2, *used, first, 25);
+        for (int l = 0 ; l < LANES ; l++) {
+            bool expected = first+l < 25 && hasuniquedistance(size, Arrangement::make(prefix[0], prefix[1], pts[first+l]));
+            CHECK( ((mask>>l)&1) == expected );
+        }
+    }
+    CHECK( (extensionmask(size.dim, cols, prefix, 2, *used, 16, 20) >> 4) == 0 );
+}
+TEST_CASE("kernels")
+{
+    // every supported kernel should give the same masks as the generic one.
+    for (auto size : { Size(2, 9), Size(3, 4), Size(5, 2) }) {
+        auto pts = allpoints(size);
+        PointColumns cols(size, pts);
+        std::unique_ptr<FixedSet> used(new FixedSet(maxdist2(size)));
+
+        Point prefix[3] = { pts[0], pts[3], pts[pts.size()/2] };
+        for (int i = 0 ; i < 3 ; i++)
+            for (int j = 0 ; j < i ; j++)
+                used->add(dist2(prefix[i], prefix[j]));
+
+        for (int kernel = 0 ; kernel < NKERNELS ; kernel++) {
+            if (!kernelsupported(kernel))
+                continue;
+            for (int nprefix = 0 ; nprefix <= 3 ; nprefix++)
+                for (int first = 0 ; first < pts.size() ; first += 5)
+                    CHECK( ExtensionKernel<int, int>::run(kernel, size.dim, cols, prefix, nprefix, *used, first, pts.size()-1)
+                           == extensionmask(size.dim, cols, prefix, nprefix, *used, first, pts.size()-1) );
+        }
+    }
+    CHECK( kernelsupported(KERNEL_GENERIC) );
+    CHECK( kernelsupported(bestkernel()) );
+    CHECK( findkernel("generic") == KERNEL_GENERIC );
+    CHECK( findkernel("avx2") == KERNEL_AVX2 );
+    CHECK( findkernel("sse9") == -1 );
+}
+TEST_CASE("gridsearch")
+{
+    // the depth first search should find exactly the same arrangements as a full sweep.
+    for (auto [dim, width, n] : { std::tuple(2, 3, 3), std::tuple(2, 4, 4), std::tuple(3, 2, 3), std::tuple(2, 5, 2), std::tuple(1, 1, 1) }) {
+        Size size(dim, width);
+        auto pts = allpoints(size);
+        std::vector<Arrangement> expected;
+        for (auto& c : generatecombinations(n, pts.size())) {
+            Arrangement a;
+            for (int i = 0 ; i < n ; i++)
+                a.add(pts[c[i]]);
+            if (hasuniquedistance(size, a))
+                expected.emplace_back(a);
+        }
+
+        std::vector<Arrangement> found;
+        GridSearch search(Shape(size, n));
+        search.run([&](const IndexArrangement& a) { found.emplace_back(a.decode(size)); });
+
+        REQUIRE( found.size() == expected.size() );
+        for (int i = 0 ; i < found.size() ; i++)
+            CHECK( found[i] == expected[i] );
+    }
+}
+TEST_CASE("specialized")
+{
+    CHECK( findspecialized(Size(2, 6), 6) );
+    CHECK_FALSE( findspecialized(Size(2, 6), 5) );
+
+    SolverOptions generic;
+    generic.generic = true;
+    for (auto [dim, width, n] : { std::tuple(2, 5, 5), std::tuple(3, 3, 3), std::tuple(4, 2, 3) }) {
+        auto a = solve(Size(dim, width), n, SolverOptions());
+        auto b = solve(Size(dim, width), n, generic);
+        CHECK( a.specialized );
+        CHECK_FALSE( b.specialized );
+        CHECK( a.solutions == b.solutions );
+        CHECK( a.countu == b.countu );
+    }
 }
+TEST_CASE("wide")
+{
+    CHECK_FALSE( needswide(Size(3, 7), 10) );
+    CHECK( needswide(Size(3, 7), 11) );
+    CHECK( needswide(Size(9, 2), 2) );
+    CHECK( needswide(Size(2, 300), 3) );
+
+    for (auto [dim, width, n] : { std::tuple(2, 5, 5), std::tuple(3, 3, 3), std::tuple(2, 4, 3), std::tuple(4, 2, 3) }) {
+        auto a = solve(Size(dim, width), n, SolverOptions());
+        auto b = searchwide(Size(dim, width), n, SolverOptions());
+        CHECK( a.solutions == b.solutions );
+        CHECK( a.countu == b.countu );
+    }
+
+    // wide canonical arrangements are equal for the same classes as those of GridSymmetry.
+    Size size(3, 4);
+    GridSymmetry symmetry(size);
+    WideSearch search(size, 4);
+    auto da = Arrangement::make(make<Point>(3,0,1), make<Point>(0,1,2), make<Point>(2,2,1), make<Point>(1,3,3));
+    Permutation perm(3);
+    perm.next();
+    std::vector<IndexArrangement> arrangements = {
+        IndexArrangement::encode(size, da),
+        IndexArrangement::encode(size, rotatearrangement(size, 5, perm, da)),
+        IndexArrangement::encode(size, Arrangement::make(make<Point>(3,0,1), make<Point>(0,1,2), make<Point>(2,2,1), make<Point>(1,3,2))),
+    };
+    std::vector<WideArrangement> keys;
+    for (auto& a : arrangements) {
+        WideArrangement key;
+        search.canonical(WideArrangement(a.begin(), a.end()), key);
+        keys.push_back(key);
+    }
+    for (int i=0 ; i<3 ; i++)
+        for (int j=0 ; j<3 ; j++)
+            CHECK( (keys[i] == keys[j]) == (symmetry.canonical(KERNEL_GENERIC, arrangements[i]) == symmetry.canonical(KERNEL_GENERIC, arrangements[j])) );
+    CHECK( keys[0] == keys[1] );
+
+    // every pair of corners of a hypercube is at one of `dim` distances.
+    auto r = solve(Size(9, 2), 2, SolverOptions());
+    CHECK( r.solutions == 9 );
+    CHECK( r.countu == 512*511/2 );
 
+    CHECK( solve(Size(2, 3), 11, SolverOptions()).solutions == 0 );
+}
+TEST_CASE("stats")
+{
+    SolverOptions opts;
+    opts.stats = STATS_TEXT;
+    opts.nshards = 2;
+    for (auto [dim, width, n] : { std::tuple(3, 4, 4), std::tuple(2, 6, 5) }) {
+        for (bool wide : { false, true }) {
+            auto r = wide ? searchwide(Size(dim, width), n, opts) : solve(Size(dim, width), n, opts);
+            REQUIRE( r.stats.depths.size() == size_t(n) );
+            uint64_t nodes = 0, solutions = 0;
+            for (auto& d : r.stats.depths) {
+                CHECK( d.candidates == d.nodes + d.pruned[PRUNE_COLLISION] + d.pruned[PRUNE_ISOSCELES] + d.pruned[PRUNE_SHARD] );
+                nodes += d.nodes;
+                solutions += d.solutions;
+            }
+            CHECK( nodes == r.nodes );
+            CHECK( solutions == r.solutions );
+            CHECK( r.stats.depths[n-1].nodes == r.countu );
+            CHECK( r.stats.depths[n-1].pruned[PRUNE_SYMMETRY] == r.countu - r.solutions );
+            CHECK( r.stats.depths[0].pruned[PRUNE_COLLISION] == 0 );
+        }
+    }
+}
+TEST_CASE("estimate")
+{
+    SolverOptions opts;
+    opts.stats = STATS_TEXT;
+    for (auto [dim, width, n] : { std::tuple(3, 4, 4), std::tuple(2, 6, 5) }) {
+        auto r = solve(Size(dim, width), n, opts);
+        auto e = estimatesearch(opts, Size(dim, width), n, 20000);
+        REQUIRE( e.nodes.size() == size_t(n+1) );
+        // the root always has the same children.
+        CHECK( e.nodes[1] == doctest::Approx(r.stats.depths[0].nodes) );
+        CHECK( e.total[0] == doctest::Approx(r.nodes).epsilon(2*e.error[0]) );
+        CHECK( e.total[1] == doctest::Approx(r.countu).epsilon(2*e.error[1]) );
+        CHECK( e.error[1] < 0.1 );
+    }
+}
+TEST_CASE("phases")
+{
+    auto r = solve(Size(3, 4), 4, SolverOptions());
+    CHECK( r.phases.calls[PHASE_DEDUP] == r.countu );
+#ifdef KERNEL_X86
+    CHECK( r.phases.total > 0 );
+    CHECK( r.phases.timed[PHASE_DISTANCES] == (r.phases.calls[PHASE_DISTANCES]+PHASESAMPLE/2)/PHASESAMPLE );
+    double sum = 0;
+    for (int p=0 ; p<NPHASES ; p++) {
+        CHECK( r.phases.estimate(p) >= 0 );
+        CHECK( r.phases.estimate(p) <= r.phases.total );
+        sum += r.phases.estimate(p);
+    }
+    CHECK( sum == doctest::Approx(r.phases.total) );
+
+    // sampled times adding up to more than the whole search are scaled down.
+    PhaseTimers timers;
+    timers.total = 1000;
+    timers.calls[PHASE_DISTANCES] = timers.calls[PHASE_DEDUP] = 2;
+    timers.timed[PHASE_DISTANCES] = timers.timed[PHASE_DEDUP] = 1;
+    timers.cycles[PHASE_DISTANCES] = 600;
+    timers.cycles[PHASE_DEDUP] = 400;
+    CHECK( timers.estimate(PHASE_DISTANCES) == doctest::Approx(600) );
+    CHECK( timers.estimate(PHASE_DEDUP) == doctest::Approx(400) );
+    CHECK( timers.estimate(PHASE_ENUMERATE) == 0 );
+#endif
+}
+TEST_CASE("progress")
+{
+    SearchProgress progress;
+    progress.start(10, 3);
+    CHECK( progress.coverage() == 0 );
+    // before { 2, 3, 4 } are the 36+28 combinations starting with 0 or 1, and { 2, 3, x }.
+    progress.publish(0, 2, 0);
+    progress.publish(1, 3, 0);
+    progress.publish(2, 4, 0);
+    CHECK( progress.coverage() == doctest::Approx(64.0/120) );
+    // a stale deeper index is ignored.
+    progress.publish(1, 5, 0);
+    CHECK( progress.coverage() == doctest::Approx((64+6+5)/120.0) );
+    // also when it is larger than the new index.
+    progress.publish(1, 3, 0);
+    progress.publish(2, 8, 0);
+    progress.publish(1, 5, 0);
+    CHECK( progress.coverage() == doctest::Approx((64+6+5)/120.0) );
+
+    SolverOptions opts;
+    opts.progress = &progress;
+    auto r = solve(Size(2, 5), 4, opts);
+    CHECK( progress.coverage() == 1 );
+    CHECK( SearchProgress::get(progress.countu) == r.countu );
+    CHECK( SearchProgress::get(progress.solutions) == r.solutions );
+
+    // the JSON reporter ends with a "finished" record.
+    int fds[2];
+    REQUIRE( pipe(fds) == 0 );
+    ProgressReporter(progress, fds[1], "\"width\":5,", 10).stop();
+    close(fds[1]);
+    char buf[1024];
+    ssize_t n = read(fds[0], buf, sizeof(buf)-1);
+    close(fds[0]);
+    REQUIRE( n > 0 );
+    std::string line(buf, n);
+    CHECK( line.back() == '\n' );
+    CHECK( line.find("\"width\":5,\"coverage\":1.000000,") != std::string::npos );
+    CHECK( line.find("\"countu\":" + std::to_string(r.countu) + ",") != std::string::npos );
+    CHECK( line.find("\"finished\":true}") != std::string::npos );
+}
 TEST_CASE("uniquedist")
 {
     CHECK( hasuniquedistance(Size(2, 3), Arrangement::make()) );
@@ -119,6 +364,480 @@ TEST_CASE("rotatearrangement")
     CHECK( rotatearrangement(Size(2,3), 0, make<Permutation>(1, 0), a) == Arrangement::make( make<Point>(0, 0),  make<Point>(1, 0),  make<Point>(2, 1) ) );
     CHECK( rotatearrangement(Size(2,3), 3, make<Permutation>(1, 0), a) == Arrangement::make( make<Point>(2, 2),  make<Point>(1, 2),  make<Point>(0, 1) ) );
 }
+TEST_CASE("packedpoint")
+{
+    for (auto size : { Size(2, 7), Size(3, 5), Size(8, 2), Size(4, 16) }) {
+        auto pts = allpoints(size);
+        int step = 1 + pts.size()/64;
+        for (int i = 0 ; i < pts.size() ; i += step)
+            for (int j = 0 ; j < pts.size() ; j += step) {
+                CHECK( PackedPoint(pts[i]).unpack(size.dim) == pts[i] );
+                CHECK( dist2(PackedPoint(pts[i]), PackedPoint(pts[j])) == dist2(pts[i], pts[j]) );
+            }
+    }
+    CHECK( dist2(PackedPoint(make<Point>(15,0,15,0,15,0,15,0)), PackedPoint(make<Point>(0,15,0,15,0,15,0,15))) == 8*225 );
+}
+TEST_CASE("packedtransform")
+{
+    for (auto size : { Size(2, 4), Size(3, 3), Size(4, 5) }) {
+        auto pts = allpoints(size);
+        Permutation perm(size.dim);
+        auto transforms = packedtransforms(size);
+        int t = 0;
+        for (int flip = 0 ; flip < (1<<size.dim) ; flip++)
+            do {
+                for (auto& p : pts)
+                    CHECK( transforms[t](PackedPoint(p)) == PackedPoint(rotatepoint(size, flip, perm, p)) );
+                t++;
+            } while (perm.next());
+        CHECK( t == transforms.size() );
+        CHECK( cachedtransforms(size).size() == transforms.size() );
+        CHECK( cachedtransforms(size)[t-1](PackedPoint(pts[1])) == transforms[t-1](PackedPoint(pts[1])) );
+    }
+}
+TEST_CASE("indexarrangement")
+{
+    Size size(3, 4);
+    for (auto& p : allpoints(size))
+        CHECK( makepoint(size, encodepoint(size, p)) == p );
+
+    auto a = Arrangement::make(make<Point>(3,0,0), make<Point>(0,1,2), make<Point>(0,0,1));
+    auto ia = IndexArrangement::encode(size, a);
+    CHECK( ia.n == 3 );
+    CHECK( ia[0] == 1 );
+    CHECK( ia[1] == 6 );
+    CHECK( ia[2] == 48 );
+    CHECK( ia.decode(size) == a );
+
+    auto ib = IndexArrangement::encode(size, Arrangement::make(make<Point>(0,0,1), make<Point>(0,1,2), make<Point>(3,0,1)));
+    CHECK( ia != ib );
+    CHECK( ia < ib );
+    CHECK_FALSE( ib < ia );
+    CHECK( ib == IndexArrangement::encode(size, ib.decode(size)) );
+}
+TEST_CASE("gridsymmetry")
+{
+    // the packed and the generic symmetry checks should agree.
+    for (auto size : { Size(3, 3), Size(2, 17) }) {
+        GridSymmetry symmetry(size);
+        CHECK( symmetry.packed.empty() == !PackedPoint::fits(size) );
+
+        auto a = Arrangement::make(make<Point>(0,0,0), make<Point>(0,1,2), make<Point>(2,2,1));
+        if (size.dim == 2)
+            a = Arrangement::make(make<Point>(0,0), make<Point>(5,16), make<Point>(2,1));
+        auto b = size.dim == 2 ? rotatearrangement(size, 2, make<Permutation>(1, 0), a)
+                               : rotatearrangement(size, 5, make<Permutation>(2, 0, 1), a);
+        auto ia = IndexArrangement::encode(size, a);
+        auto ib = IndexArrangement::encode(size, b);
+
+        for (int kernel = 0 ; kernel < NKERNELS ; kernel++) {
+            if (!kernelsupported(kernel))
+                continue;
+            auto ca = symmetry.canonical(kernel, ia);
+            CHECK( ca == symmetry.canonical(kernel, ib) );
+            CHECK( ca == symmetry.canonical(kernel, ca) );
+            CHECK_FALSE( ib < ca );
+            CHECK( istransformof(size, ca.decode(size), a) );
+
+            for (int i = 0 ; i < 20 ; i++) {
+                auto c = size.dim == 2 ? Arrangement::make(make<Point>(i%3,0), make<Point>(1,i%2), make<Point>(2,2))
+                                       : Arrangement::make(make<Point>(0,0,i%3), make<Point>(1,i%2,2), make<Point>(2,1,1));
+                CHECK( ca != symmetry.canonical(kernel, IndexArrangement::encode(size, c)) );
+            }
+        }
+    }
+}
+TEST_CASE("solutionstore")
+{
+    Size size(3, 4);
+    SolutionStore store(3);
+    CHECK( store.empty() );
+
+    std::vector<IndexArrangement> all;
+    for (auto& c : generatecombinations(3, 30)) {
+        IndexArrangement a;
+        for (int i=0 ; i<3 ; i++)
+            a.add(c[i]);
+        all.push_back(a);
+    }
+    for (auto& a : all)
+        CHECK( store.insert(a) );
+    CHECK( store.size() == all.size() );
+    CHECK_FALSE( store.insert(all[17]) );
+    CHECK( store.size() == all.size() );
+
+    for (uint64_t i=0 ; i<store.size() ; i++)
+        CHECK( store[i] == all[i] );
+    CHECK( store.contains(all[0]) );
+    CHECK_FALSE( store.contains(IndexArrangement::encode(size, Arrangement::make(make<Point>(3,3,3), make<Point>(0,0,0), make<Point>(0,0,1)))) );
+
+    std::stringstream ss;
+    store.write(ss);
+    SolutionStore copy(0);
+    CHECK( copy.read(ss) );
+    CHECK( copy.size() == store.size() );
+    CHECK( copy.arena == store.arena );
+    for (auto& a : all)
+        CHECK( copy.contains(a) );
+
+    std::stringstream truncated(ss.str().substr(0, 20));
+    CHECK_FALSE( copy.read(truncated) );
+    // a failed read keeps the contents.
+    CHECK( copy.size() == store.size() );
+    CHECK( copy.arena == store.arena );
+    for (auto& a : all)
+        CHECK( copy.contains(a) );
+}
+TEST_CASE("catalog")
+{
+    const char *path = "unittests-catalog.tmp";
+    Size size(3, 3);
+    GridSymmetry symmetry(size);
+
+    SolverOptions opts;
+    opts.catalog = path;
+    auto r = solve(size, 3, opts);
+    CHECK_FALSE( r.catalogfailed );
+
+    Catalog catalog;
+    REQUIRE( catalog.open(path) );
+    CHECK( catalog.size().dim == 3 );
+    CHECK( catalog.size().width == 3 );
+    CHECK( catalog.ncounters() == 3 );
+    CHECK( catalog.count() == r.solutions );
+    CHECK( catalog.header->countu == r.countu );
+    CHECK( catalog.header->symmetry == SYMMETRY_ROTATE_REFLECT );
+
+    for (uint64_t i=1 ; i<catalog.count() ; i++)
+        CHECK( catalog[i-1] < catalog[i] );
+    for (uint64_t i=0 ; i<catalog.count() ; i++) {
+        CHECK( catalog.contains(catalog[i]) );
+        CHECK( catalog.lowerbound(catalog[i]) == i );
+        CHECK( symmetry.canonical(KERNEL_GENERIC, catalog[i]) == catalog[i] );
+        CHECK( hasuniquedistance(size, catalog[i].decode(size)) );
+    }
+    // not canonical, and too few counters.
+    auto a = IndexArrangement::encode(size, Arrangement::make(make<Point>(2,2,2), make<Point>(2,2,1), make<Point>(2,0,2)));
+    CHECK_FALSE( catalog.contains(a) );
+    CHECK( catalog.contains(symmetry.canonical(KERNEL_GENERIC, a)) );
+    CHECK_FALSE( catalog.contains(IndexArrangement()) );
+    IndexArrangement prefix;
+    prefix.add(catalog[0][0]);
+    prefix.add(catalog[0][1]);
+    CHECK_FALSE( catalog.contains(prefix) );
+
+    // a truncated file is rejected.
+    truncate(path, sizeof(CatalogHeader)+2);
+    CHECK_FALSE( catalog.open(path) );
+    unlink(path);
+    CHECK_FALSE( catalog.open(path) );
+}
+TEST_CASE("combinationrank")
+{
+    Rank r = 0;
+    for (auto& c : generatecombinations(3, 12)) {
+        IndexArrangement a;
+        for (int i=0 ; i<3 ; i++)
+            a.add(c[i]);
+        CHECK( combinationrank(a, 12) == r );
+        CHECK( combinationunrank(r, 3, 12) == a );
+        r++;
+    }
+    CHECK( r == binomial(12, 3) );
+    CHECK( binomial(65536, 4) == 768543969628897280ULL );
+    CHECK( ranksfit(65536, 5) );
+    CHECK( tostring(binomial(65536, 5)) == "10072844683544179310592" );
+    CHECK( tostring(binomial(15*15*15, 9)) == "154904699387963488183481625" );
+    CHECK( tostring(binomial(65536, 8)) == "8435937701339247225663743728803840" );
+    CHECK_FALSE( ranksfit(65536, 10) );
+    CHECK( binomial(3, 4) == 0 );
+    CHECK( tostring(0) == "0" );
+    CHECK( generatecombinations::totalcombinations(9, 15*15*15) == binomial(15*15*15, 9) );
+
+    // ranks beyond 64 bits.
+    IndexArrangement last;
+    for (int i=0 ; i<9 ; i++)
+        last.add(15*15*15-9+i);
+    CHECK( combinationrank(last, 15*15*15) == binomial(15*15*15, 9)-1 );
+    CHECK( combinationunrank(binomial(15*15*15, 9)-1, 9, 15*15*15) == last );
+    auto mid = combinationunrank(binomial(15*15*15, 9)/2, 9, 15*15*15);
+    CHECK( combinationrank(mid, 15*15*15) == binomial(15*15*15, 9)/2 );
+    // unranking round trips for the largest grids.
+    for (Rank r : { Rank(0), Rank(1), binomial(65536, 8)/3, binomial(65536, 8)-1 })
+        CHECK( combinationrank(combinationunrank(r, 8, 65536), 65536) == r );
+
+    std::string buf;
+    for (Rank v : { Rank(0), Rank(127), Rank(128), Rank(300), ~Rank(0) })
+        putvarint(buf, v);
+    CHECK( buf.size() == 1+1+2+2+19 );
+    auto p = (const uint8_t*)buf.data(), end = p+buf.size();
+    for (Rank v : { Rank(0), Rank(127), Rank(128), Rank(300), ~Rank(0) }) {
+        Rank x;
+        p = getvarint(p, end, x);
+        REQUIRE( p );
+        CHECK( x == v );
+    }
+    Rank x;
+    CHECK( getvarint(end-19, end-1, x) == nullptr );
+}
+TEST_CASE("rankcatalog")
+{
+    const char *path = "unittests-rankcatalog.tmp";
+    Size size(2, 6);
+
+    SolverOptions opts;
+    opts.catalog = path;
+    opts.compress = true;
+    auto r = solve(size, 5, opts);
+    CHECK_FALSE( r.catalogfailed );
+
+    RankCatalog catalog;
+    REQUIRE( catalog.open(path) );
+    CHECK( catalog.count() == r.solutions );
+    CHECK( catalog.header->countu == r.countu );
+    CHECK( catalog.nblocks > 1 );
+    CHECK( catalog.header->blockindex % alignof(RankBlock) == 0 );
+
+    GridSymmetry symmetry(size);
+    auto d = catalog.decoder();
+    Rank rank, prev = 0;
+    uint64_t n = 0;
+    std::set<Rank> ranks;
+    while (d.next(rank)) {
+        if (n)
+            CHECK( prev < rank );
+        auto a = combinationunrank(rank, 5, 36);
+        CHECK( hasuniquedistance(size, a.decode(size)) );
+        CHECK( symmetry.canonical(KERNEL_GENERIC, a) == a );
+        CHECK( catalog.contains(a) );
+        ranks.insert(rank);
+        prev = rank;
+        n++;
+    }
+    CHECK( n == r.solutions );
+    for (auto rank : ranks)
+        CHECK( catalog.containsrank(rank+1) == (ranks.count(rank+1) != 0) );
+    CHECK_FALSE( catalog.containsrank(0) );
+
+    // decoding from a block gives the same ranks as decoding from the start.
+    auto d2 = catalog.decoder(1);
+    auto d1 = catalog.decoder();
+    for (int i=0 ; i<RANKBLOCKSIZE ; i++)
+        d1.next(rank);
+    Rank r1, r2;
+    while (d1.next(r1)) {
+        REQUIRE( d2.next(r2) );
+        CHECK( r1 == r2 );
+    }
+
+    CHECK_FALSE( Catalog().open(path) );
+    unlink(path);
+}
+TEST_CASE("merge")
+{
+    Size size(3, 3);
+    auto full = solve(size, 3, SolverOptions());
+
+    std::vector<std::string> paths;
+    uint64_t countu = 0;
+    for (int i=0 ; i<3 ; i++) {
+        paths.push_back("unittests-shard" + std::to_string(i) + ".tmp");
+        SolverOptions opts;
+        opts.shard = i;
+        opts.nshards = 3;
+        opts.catalog = paths.back().c_str();
+        opts.compress = i==1;
+        auto r = solve(size, 3, opts);
+        CHECK( r.solutions <= full.solutions );
+        countu += r.countu;
+    }
+    CHECK( countu == full.countu );
+
+    std::vector<const char*> inputs;
+    for (auto& path : paths)
+        inputs.push_back(path.c_str());
+    const char *merged = "unittests-merged.tmp";
+    CHECK( mergecatalogs(merged, false, inputs) == 0 );
+
+    Catalog catalog;
+    REQUIRE( catalog.open(merged) );
+    CHECK( catalog.count() == full.solutions );
+    CHECK( catalog.header->countu == full.countu );
+    for (uint64_t i=1 ; i<catalog.count() ; i++)
+        CHECK( catalog[i-1] < catalog[i] );
+    catalog.close();
+
+    // catalogs for another grid are refused.
+    SolverOptions opts;
+    opts.catalog = merged;
+    solve(Size(2, 3), 3, opts);
+    inputs.push_back(merged);
+    CHECK( mergecatalogs("unittests-merged2.tmp", false, inputs) == 1 );
+
+    // ranks of 10 of 65536 points do not fit in 128 bits, so can not be compressed.
+    CatalogWriter writer;
+    CHECK_FALSE( writer.open("unittests-merged2.tmp", Size(2, 256), 10, true) );
+    CHECK( writer.open("unittests-merged2.tmp", Size(2, 256), 10, false) );
+
+    for (auto path : inputs)
+        unlink(path);
+    unlink("unittests-merged2.tmp");
+}
+TEST_CASE("spill")
+{
+    Size size(2, 8);
+    auto full = solve(size, 5, SolverOptions());
+
+    SolverOptions opts;
+    opts.memorylimit = 4096;
+    opts.spilldir = ".";
+    opts.catalog = "unittests-spilled.tmp";
+    auto r = solve(size, 5, opts);
+    CHECK_FALSE( r.catalogfailed );
+    CHECK( r.solutions == full.solutions );
+    CHECK( r.countu == full.countu );
+
+    Catalog catalog;
+    REQUIRE( catalog.open(opts.catalog) );
+    CHECK( catalog.count() == full.solutions );
+    for (uint64_t i=1 ; i<catalog.count() ; i++)
+        CHECK( catalog[i-1] < catalog[i] );
+    catalog.close();
+    unlink(opts.catalog);
+
+    // without a catalog, and with a spill directory which does not exist.
+    opts.catalog = nullptr;
+    CHECK( solve(size, 5, opts).solutions == full.solutions );
+
+    // the stats count each class once, also when it was found again after a spill.
+    SolverOptions stats;
+    stats.stats = STATS_TEXT;
+    auto fullstats = solve(size, 5, stats);
+    opts.stats = STATS_TEXT;
+    auto spilledstats = solve(size, 5, opts);
+    CHECK( spilledstats.stats.depths[4].solutions == fullstats.stats.depths[4].solutions );
+    CHECK( spilledstats.stats.depths[4].pruned[PRUNE_SYMMETRY] == fullstats.stats.depths[4].pruned[PRUNE_SYMMETRY] );
+
+    opts.spilldir = "unittests-nonexistent";
+    CHECK( solve(size, 5, opts).catalogfailed );
+}
+TEST_CASE("solutionwriter")
+{
+    Size size(2, 4);
+    auto a = IndexArrangement::encode(size, Arrangement::make(make<Point>(0,0), make<Point>(0,1), make<Point>(3,0)));
+    auto key = IndexArrangement::encode(size, Arrangement::make(make<Point>(0,0), make<Point>(1,0), make<Point>(0,3)));
+
+    for (int format : { FORMAT_JSONL, FORMAT_CSV }) {
+        const char *path = "unittests-writer.tmp";
+        int fd = open(path, O_WRONLY|O_CREAT|O_TRUNC, 0644);
+        REQUIRE( fd != -1 );
+        SolutionWriter writer(fd, format, size);
+        // enough lines for several chunks.
+        for (int i=0 ; i<10000 ; i++)
+            writer.add(a, key);
+        CHECK( writer.close() );
+        ::close(fd);
+
+        std::ifstream is(path);
+        std::string line, first;
+        int n = 0;
+        if (format == FORMAT_CSV) {
+            std::getline(is, line);
+            CHECK( line == "rank,indices,coordinates,key" );
+        }
+        while (std::getline(is, line)) {
+            if (n++ == 0)
+                first = line;
+            else if (line != first)
+                break;
+        }
+        CHECK( n == 10000 );
+        if (format == FORMAT_JSONL)
+            CHECK( first == "{\"indices\":[0,1,12],\"coords\":[[0,0],[0,1],[3,0]],\"key\":[0,3,4],\"rank\":\"27\"}" );
+        else
+            CHECK( first == "27,0 1 12,0 0;0 1;3 0,0 3 4" );
+        unlink(path);
+    }
+}
+TEST_CASE("render")
+{
+    auto render = [](Size size, const Arrangement& a) {
+        std::string out;
+        renderarrangement(out, size, IndexArrangement::encode(size, a));
+        return out;
+    };
+    CHECK( render(Size(2, 3), Arrangement::make(make<Point>(2,0), make<Point>(0,1), make<Point>(1,1))) == "..*\n**.\n...\n\n" );
+    CHECK( render(Size(3, 2), Arrangement::make(make<Point>(1,0,0), make<Point>(0,1,1))) == ".*  ..  \n..  *.  \n\n" );
+    CHECK( render(Size(4, 2), Arrangement::make(make<Point>(1,0,0,1), make<Point>(0,1,1,0))) ==
+            "(.,.,.,0)\n..  ..  \n..  *.  \n\n"
+            "(.,.,.,1)\n.*  ..  \n..  ..  \n\n" );
+    CHECK( render(Size(1, 4), Arrangement::make(make<Point>(1), make<Point>(3))) == "{(1), (3)}\n" );
+
+    // wide arrangements, in 4 dimensions, and listed beyond MAXRENDERPOINTS.
+    std::string out;
+    renderarrangement(out, Size(4, 2), WideArrangement { 6, 9 });
+    CHECK( out == "(.,.,.,0)\n..  ..  \n..  *.  \n\n"
+                  "(.,.,.,1)\n.*  ..  \n..  ..  \n\n" );
+    out.clear();
+    renderarrangement(out, Size(3, 200), WideArrangement { 0, 40199 });
+    CHECK( out == "{(0,0,0), (1,0,199)}\n" );
+}
+TEST_CASE("gridtables")
+{
+    const char *path = "./mpmp7-tables-3-4-v1";
+    unlink(path);
+    Size size(4, 3);
+    GridSymmetry built(size, ".");
+    GridSymmetry mapped(size, ".");
+    GridSymmetry uncached(size);
+    CHECK( built.tables->file.data != nullptr );
+    CHECK( mapped.tables->file.data != nullptr );
+    CHECK( uncached.tables->file.data == nullptr );
+    REQUIRE( mapped.transforms.size() == uncached.transforms.size() );
+    CHECK( std::equal(mapped.packed.begin(), mapped.packed.end(), uncached.packed.begin(), uncached.packed.end()) );
+    for (size_t t=0 ; t<mapped.transforms.size() ; t++)
+        for (auto p : mapped.packed)
+            if (mapped.transforms[t](p) != uncached.transforms[t](p))
+                FAIL( "transform " << t << " differs" );
+
+    IndexArrangement a = IndexArrangement::encode(size, Arrangement::make(make<Point>(2,0,1,0), make<Point>(0,1,1,0), make<Point>(1,1,0,2)));
+    CHECK( mapped.canonical(KERNEL_GENERIC, a) == uncached.canonical(KERNEL_GENERIC, a) );
+
+    // a file for another grid is not used.
+    rename(path, "./mpmp7-tables-3-3-v1");
+    GridSymmetry other(Size(3, 3), ".");
+    CHECK( other.packed.size() == 27 );
+    unlink("./mpmp7-tables-3-3-v1");
+    unlink(path);
+}
+TEST_CASE("verify")
+{
+    Verifier verifier(Size(2, 4), 3, KERNEL_GENERIC, true, true);
+    IndexArrangement a, key;
+    CHECK( verifier.parse("0 0 1 0 3 0", a) == VERIFY_OK );
+    CHECK( verifier.check(a, key) == VERIFY_OK );
+    CHECK( verifier.parse("{\"indices\":[0,1,3],\"coords\":[[0,0],[0,1],[0,3]],\"key\":[0,4,12],\"rank\":\"46\"}", a) == VERIFY_OK );
+    CHECK( a == IndexArrangement::encode(Size(2, 4), Arrangement::make(make<Point>(0,0), make<Point>(0,1), make<Point>(0,3))) );
+    CHECK( verifier.parse("43,0 1 6,0 0;0 1;1 2,0 4 9", a) == VERIFY_OK );
+    CHECK( a == IndexArrangement::encode(Size(2, 4), Arrangement::make(make<Point>(0,0), make<Point>(0,1), make<Point>(1,2))) );
+
+    // plain coordinates with three commas are not a csv record.
+    CHECK( verifier.parse("0,0 1,0 2,2", a) == VERIFY_OK );
+    CHECK( a == IndexArrangement::encode(Size(2, 4), Arrangement::make(make<Point>(0,0), make<Point>(1,0), make<Point>(2,2))) );
+    CHECK( verifier.parse("(0,0) (0,1)", a) == VERIFY_COUNT );
+    CHECK( verifier.parse("0 0 0 4 1 1", a) == VERIFY_RANGE );
+    CHECK( verifier.parse("none", a) == VERIFY_PARSE );
+    CHECK( verifier.parse("0 0 0 0 1 1", a) == VERIFY_OK );
+    CHECK( verifier.check(a, key) == VERIFY_SAMEPOINT );
+    CHECK( verifier.parse("0 0 1 1 2 2", a) == VERIFY_OK );
+    CHECK( verifier.check(a, key) == VERIFY_DISTANCE );
+    CHECK( verifier.parse("3 3 3 2 2 0", a) == VERIFY_OK );
+    CHECK( verifier.check(a, key) == VERIFY_NOTCANONICAL );
+
+    std::atomic<int> total(0);
+    parallelfor(1000, 4, [&](uint64_t i) { total += i; });
+    CHECK( total == 499500 );
+}
 TEST_CASE("istransform")
 {
     CHECK( istransformof(Size(4,3), Arrangement::make(make<Point>(0,0,0,0),  make<Point>(1,1,1,1)), Arrangement::make(make<Point>(2,2,2,2),  make<Point>(1,1,1,1))) );